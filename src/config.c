@@ -0,0 +1,173 @@
+/*
+ * config.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include "defs.h"
+#include "config.h"
+#include "crc.h"
+#include "nvm.h"
+
+#define CONFIG_SLOT_SIZE 16
+#define CONFIG_SLOT_COUNT (NVM_SETTINGS_SIZE / CONFIG_SLOT_SIZE)
+#define CALIBRATION_SLOT_SIZE (NVM_CALIBRATION_SIZE / 2)
+
+/* A settings record as stored in EEPROM. Every save goes to the
+ * next slot of a ring over the settings area so the wear is spread
+ * over all the slots, the sequence number tells which one is the
+ * newest.
+ */
+struct config_record
+{
+	uint8_t version;
+	uint8_t sequence;
+	struct config_data data;
+	uint8_t reserved[CONFIG_SLOT_SIZE - 4 - sizeof(struct config_data)];
+	uint16_t crc;	//CRC16 of all the bytes above
+};
+
+/* The ADC calibration has an EEPROM area of its own since it is
+ * only written when a unit is calibrated. The two slots are written
+ * in turn so a power failure during a write leaves the previous
+ * calibration in place.
+ */
+struct calibration_record
+{
+	uint8_t version;
+	uint8_t sequence;
+	struct control_calibration data;
+	uint16_t crc;	//CRC16 of all the bytes above
+};
+
+static struct config_record record;	//record being written, owned by the EEPROM writer until it is done
+static struct config_data staged;	//latest settings, written once the EEPROM is free
+static uint8_t staged_dirty = FALSE;
+static uint8_t slot_next = 0;	//next slot to be written
+static uint8_t slot_sequence = 0;	//sequence number of the next record
+static struct calibration_record calibration_record;	//owned by the EEPROM writer until it is done
+
+
+static inline uint16_t slot_address(uint8_t slot)
+{
+	return NVM_SETTINGS_BASE + (uint16_t)slot * CONFIG_SLOT_SIZE;
+}
+
+
+uint8_t config_load(struct config_data *data)
+{
+	/* Restores the newest valid record in a single pass over
+	 * the slots. Records with a bad CRC, e.g one that was being
+	 * written when the power failed, or with another version are
+	 * skipped. FALSE is returned and data is left untouched when
+	 * no valid record is found.
+	 */
+	uint8_t found = FALSE;
+	uint8_t newest = 0;
+	for(uint8_t slot = 0; slot < CONFIG_SLOT_COUNT; ++slot)
+	{
+		struct config_record candidate;
+		nvm_read(slot_address(slot), &candidate, sizeof(candidate));
+		if(candidate.version != CONFIG_VERSION)
+			continue;
+		if(crc16((const uint8_t*)&candidate, sizeof(candidate) - sizeof(candidate.crc)) != candidate.crc)
+			continue;
+
+		//the sequence number wraps around, compare the difference instead of the values
+		if(!found || (int8_t)(candidate.sequence - record.sequence) > 0)
+		{
+			record = candidate;
+			newest = slot;
+			found = TRUE;
+		}
+	}
+
+	if(found)
+	{
+		*data = record.data;
+		staged = record.data;
+		slot_next = (newest + 1) % CONFIG_SLOT_COUNT;
+		slot_sequence = record.sequence + 1;
+	}
+	return found;
+}
+
+
+void config_save(const struct config_data *data)
+{
+	/* Stages the settings for writing. It only costs a compare
+	 * when nothing has changed so it can be called as often as
+	 * needed, the write itself is done by config_poll.
+	 */
+	if(!memcmp(&staged, data, sizeof(staged)))
+		return;
+	staged = *data;
+	staged_dirty = TRUE;
+	return;
+}
+
+
+void config_poll(void)
+{
+	/* Writes the staged settings once the EEPROM writer is
+	 * free. Called from the background tasks of the main loop.
+	 */
+	if(!staged_dirty || nvm_busy())
+		return;
+
+	record.version = CONFIG_VERSION;
+	record.sequence = slot_sequence;
+	record.data = staged;
+	memset(record.reserved, 0xFF, sizeof(record.reserved));
+	record.crc = crc16((const uint8_t*)&record, sizeof(record) - sizeof(record.crc));
+	if(!nvm_write(slot_address(slot_next), &record, sizeof(record)))
+		return;
+
+	staged_dirty = FALSE;
+	++slot_sequence;
+	slot_next = (slot_next + 1) % CONFIG_SLOT_COUNT;
+	return;
+}
+
+
+uint8_t config_load_calibration(struct control_calibration *calibration)
+{
+	//restores the newest valid calibration, FALSE is returned for a unit that hasn't been calibrated
+	uint8_t found = FALSE;
+	for(uint8_t slot = 0; slot < 2; ++slot)
+	{
+		struct calibration_record candidate;
+		nvm_read(NVM_CALIBRATION_BASE + slot * CALIBRATION_SLOT_SIZE, &candidate, sizeof(candidate));
+		if(candidate.version != CONFIG_VERSION)
+			continue;
+		if(crc16((const uint8_t*)&candidate, sizeof(candidate) - sizeof(candidate.crc)) != candidate.crc)
+			continue;
+		if(!found || (int8_t)(candidate.sequence - calibration_record.sequence) > 0)
+		{
+			calibration_record = candidate;
+			found = TRUE;
+		}
+	}
+	if(found)
+		*calibration = calibration_record.data;
+	return found;
+}
+
+
+uint8_t config_save_calibration(const struct control_calibration *calibration)
+{
+	/* Queues the calibration for writing over the older of the
+	 * two slots. FALSE is returned when the EEPROM writer is busy
+	 * and the save has to be retried.
+	 */
+	if(nvm_busy())
+		return FALSE;
+	uint8_t sequence = calibration_record.sequence + 1;
+	calibration_record.version = CONFIG_VERSION;
+	calibration_record.sequence = sequence;
+	calibration_record.data = *calibration;
+	calibration_record.crc = crc16((const uint8_t*)&calibration_record,
+			sizeof(calibration_record) - sizeof(calibration_record.crc));
+	return nvm_write(NVM_CALIBRATION_BASE + (sequence & 1) * CALIBRATION_SLOT_SIZE, &calibration_record,
+			sizeof(calibration_record));
+}
@@ -0,0 +1,32 @@
+/*
+ * config.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include <stdint.h>
+#include "control.h"
+
+#define CONFIG_VERSION 1	//bump whenever the layout of struct config_data changes
+
+//settings that survive a power loss
+struct config_data
+{
+	uint8_t soc_limit;	//unit = %
+	uint8_t modbus_address;
+	uint16_t countdown_time;	//count down time remaining (unit = minutes)
+	uint8_t countdown_active;	//a count down was in progress
+	uint8_t load_on;	//power to the connected load was enabled
+};
+
+uint8_t config_load(struct config_data *data);
+void config_save(const struct config_data *data);
+void config_poll(void);
+uint8_t config_load_calibration(struct control_calibration *calibration);
+uint8_t config_save_calibration(const struct control_calibration *calibration);
+
+#endif /* CONFIG_H_ */
@@ -0,0 +1,250 @@
+/*
+ * control.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include "control.h"
+#include "events.h"
+#include "pgm.h"
+#include "soc_table.h"
+
+//open circuit voltage at every SOC_TABLE_STEP % of SOC, fitted by tools/ocvfit
+static const uint16_t control_ocv_table[SOC_TABLE_POINTS] PROGMEM = SOC_TABLE_MILLIVOLTS;
+
+/* Non-critical loads on LOAD_PORT, most critical first. Their
+ * thresholds are margins above the SOC limit, so they are shed
+ * before the main load on PA0 at any limit, the least critical one
+ * first, which keeps the main load running longer.
+ */
+const struct control_load gLoad_Channels[LOAD_CHANNEL_COUNT] =
+{
+	{ 1 << 5, 5, 15 },	//PA5
+	{ 1 << 6, 15, 25 },	//PA6
+	{ 1 << 7, 25, 35 }	//PA7
+};
+
+
+void control_policy_init(struct control_policy *policy, uint8_t soc_limit)
+{
+	policy->soc_limit = soc_limit;
+	policy->buzzer_soc = CONTROL_BUZZER_SOC;
+	policy->charge_start_soc = CONTROL_CHARGE_START_SOC;
+	policy->charge_stop_soc = CONTROL_CHARGE_STOP_SOC;
+	policy->hysteresis = CONTROL_HYSTERESIS;
+	return;
+}
+
+
+uint8_t control_step(const struct control_policy *policy, struct control_state *state, uint8_t soc,
+		uint8_t external_power, uint8_t *events)
+{
+	/* Takes the control decisions for a battery sample. The
+	 * state is updated and the EVENT_ code of every transition
+	 * is written to events in the order it has to be applied,
+	 * their number is returned.
+	 */
+	uint8_t count = 0;
+	state->battery_low = 0;
+
+	if(soc < policy->soc_limit && !state->charging)
+	{
+		/* Low battery: disconnect the load, a count down in
+		 * progress has to be terminated by the caller along
+		 * with it. The buzzer warns the user once the battery gets
+		 * really low.
+		 */
+		state->battery_low = 1;
+		if(!state->buzzer_on && soc < policy->buzzer_soc)
+		{
+			state->buzzer_on = 1;
+			events[count++] = EVENT_BUZZER_ON;
+		}
+		if(state->load_on)
+		{
+			state->load_on = 0;
+			events[count++] = EVENT_LOAD_OFF;
+		}
+	}
+	else if(!state->countdown_in_progress && soc > policy->soc_limit + policy->hysteresis && !state->load_on)
+	{
+		//enough battery power, connect the load again
+		if(state->buzzer_on)
+		{
+			state->buzzer_on = 0;
+			events[count++] = EVENT_BUZZER_OFF;
+		}
+		state->load_on = 1;
+		events[count++] = EVENT_LOAD_ON;
+	}
+
+	if(external_power)
+	{
+		//battery charging from the external power supply
+		if(soc >= policy->charge_stop_soc && state->charging)
+		{
+			state->charging = 0;
+			events[count++] = EVENT_CHARGE_OFF;
+		}
+		else if(soc < policy->charge_start_soc && !state->charging)
+		{
+			state->charging = 1;
+			events[count++] = EVENT_CHARGE_ON;
+			if(state->buzzer_on)
+			{
+				state->buzzer_on = 0;
+				events[count++] = EVENT_BUZZER_OFF;
+			}
+		}
+	}
+	return count;
+}
+
+
+uint8_t control_load_soc(const struct control_policy *policy, uint8_t margin)
+{
+	//threshold of a load channel (unit = %), margin above the SOC limit
+	uint16_t soc = policy->soc_limit + margin;
+	return (soc > 100) ? 100 : soc;
+}
+
+
+uint8_t control_shed(const struct control_policy *policy, const struct control_load *loads, uint8_t count,
+		uint8_t outputs, uint8_t soc)
+{
+	/* Takes the decisions for the load channels in a single pass
+	 * over the table and returns the new outputs. Every channel
+	 * below its cutoff is shed at once but only one channel is
+	 * connected again per step, the most critical one first, so
+	 * the loads don't all draw their inrush current together.
+	 */
+	uint8_t reconnected = 0;
+	for(uint8_t i = 0; i < count; ++i)
+	{
+		const struct control_load *load = &loads[i];
+		if(outputs & load->mask)
+		{
+			if(soc < control_load_soc(policy, load->cutoff_margin))
+				outputs &= ~load->mask;
+		}
+		else if(!reconnected && soc >= control_load_soc(policy, load->reconnect_margin))
+		{
+			outputs |= load->mask;
+			reconnected = 1;
+		}
+	}
+	return outputs;
+}
+
+
+uint8_t control_soc(uint16_t millivolts)
+{
+	/* Battery voltage to SOC (unit = %), interpolated between the
+	 * points of the OCV table. The table rises with the SOC, the
+	 * voltages outside of it are 0% and 100%.
+	 */
+	uint16_t low = pgm_read_word(&control_ocv_table[0]);
+	if(millivolts <= low)
+		return 0;
+	for(uint8_t i = 1; i < SOC_TABLE_POINTS; ++i)
+	{
+		uint16_t high = pgm_read_word(&control_ocv_table[i]);
+		if(millivolts < high)
+			return (i - 1) * SOC_TABLE_STEP + (uint32_t)(millivolts - low) * SOC_TABLE_STEP / (high - low);
+		low = high;
+	}
+	return 100;
+}
+
+
+static uint8_t control_distance(uint8_t soc, uint8_t threshold)
+{
+	//SOC steps between soc and the edge of a "below threshold" decision, 0 right next to it
+	return (soc >= threshold) ? soc - threshold : threshold - 1 - soc;
+}
+
+
+uint16_t control_sample_period(const struct control_policy *policy, const struct control_load *loads, uint8_t count,
+		uint8_t soc, uint8_t change, uint16_t elapsed)
+{
+	/* Time to the next battery sample (unit = ms). The battery is
+	 * sampled every CONTROL_FAST_PERIOD next to a threshold of the
+	 * policy or of a load channel, the period grows by
+	 * CONTROL_PERIOD_GROWTH with every 1% of SOC away from the
+	 * nearest one up to CONTROL_SLOW_PERIOD.
+	 * When the SOC has moved by change over the last elapsed ms the
+	 * period is also cut so that CONTROL_SAMPLES_AHEAD samples are
+	 * taken before the nearest threshold can be reached.
+	 */
+	uint8_t distance = control_distance(soc, policy->soc_limit);
+	uint8_t thresholds[] = { policy->soc_limit + policy->hysteresis, policy->buzzer_soc, policy->charge_start_soc,
+			policy->charge_stop_soc };
+	for(uint8_t i = 0; i < sizeof(thresholds); ++i)
+		if(control_distance(soc, thresholds[i]) < distance)
+			distance = control_distance(soc, thresholds[i]);
+	for(uint8_t i = 0; i < count; ++i)
+	{
+		uint8_t cutoff = control_load_soc(policy, loads[i].cutoff_margin);
+		uint8_t reconnect = control_load_soc(policy, loads[i].reconnect_margin);
+		if(control_distance(soc, cutoff) < distance)
+			distance = control_distance(soc, cutoff);
+		if(control_distance(soc, reconnect) < distance)
+			distance = control_distance(soc, reconnect);
+	}
+
+	uint32_t period = CONTROL_FAST_PERIOD;
+	for(uint8_t i = 0; i < distance && period < CONTROL_SLOW_PERIOD; ++i)
+		period *= CONTROL_PERIOD_GROWTH;
+	if(change)
+	{
+		//the threshold is crossed after distance + 1 more steps at this rate
+		uint32_t ahead = (uint32_t)(distance + 1) * elapsed / change / CONTROL_SAMPLES_AHEAD;
+		if(ahead < period)
+			period = ahead;
+	}
+	if(period > CONTROL_SLOW_PERIOD)
+		period = CONTROL_SLOW_PERIOD;
+	return (period < CONTROL_FAST_PERIOD) ? CONTROL_FAST_PERIOD : period;
+}
+
+
+void control_calibration_init(struct control_calibration *calibration)
+{
+	//the nominal conversion of control_millivolts, for a unit that hasn't been calibrated
+	calibration->gain = ((CONTROL_MAX_MILLIVOLTS << CONTROL_CALIBRATION_SHIFT) + 1022) / 1023;	//rounded up, within 1mV of control_millivolts
+	calibration->offset = 0;
+	return;
+}
+
+
+uint8_t control_calibration_fit(struct control_calibration *calibration, uint16_t adc_low, uint16_t millivolts_low,
+		uint16_t adc_high, uint16_t millivolts_high)
+{
+	/* Finds the gain and offset of the straight line through two
+	 * calibration points. The points must be far enough apart,
+	 * the gain within 25% of the nominal one and the line has to
+	 * stay within 0 - CONTROL_CALIBRATION_MAX_MILLIVOLTS over the
+	 * whole ADC range, otherwise FALSE is returned and the
+	 * calibration is left untouched. The bounds on the points are
+	 * checked first, the shifts below overflow 32 bits without them,
+	 * the bound on the line keeps control_calibrate within 32 bits.
+	 */
+	if(adc_low > 1023 || adc_high > 1023 || millivolts_low > CONTROL_CALIBRATION_MAX_MILLIVOLTS
+			|| millivolts_high > CONTROL_CALIBRATION_MAX_MILLIVOLTS)
+		return 0;
+	if(adc_high < adc_low + CONTROL_CALIBRATION_MIN_SPAN || millivolts_high <= millivolts_low)
+		return 0;
+	int32_t gain = ((int32_t)(millivolts_high - millivolts_low) << CONTROL_CALIBRATION_SHIFT) / (adc_high - adc_low);
+	int32_t nominal = (CONTROL_MAX_MILLIVOLTS << CONTROL_CALIBRATION_SHIFT) / 1023;
+	if(gain < nominal - nominal / 4 || gain > nominal + nominal / 4)
+		return 0;
+	//rounded to the nearest mV
+	int32_t offset = ((int32_t)millivolts_low << CONTROL_CALIBRATION_SHIFT) - (int32_t)adc_low * gain
+			+ (1L << (CONTROL_CALIBRATION_SHIFT - 1));
+	//the line at ADC 0 and at ADC 1023, the second one compared without adding up past 32 bits
+	if(offset < 0 || offset > ((int32_t)CONTROL_CALIBRATION_MAX_MILLIVOLTS << CONTROL_CALIBRATION_SHIFT) - 1023 * gain)
+		return 0;
+	calibration->gain = gain;
+	calibration->offset = offset;
+	return 1;
+}
@@ -0,0 +1,119 @@
+/*
+ * control.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef CONTROL_H_
+#define CONTROL_H_
+
+#include <stdint.h>
+
+/* The battery protection decisions: load, buzzer and charger.
+ * This file doesn't depend on the AVR headers so the exact
+ * same decision code can be driven by the host tools. The
+ * caller owns the state and applies the transitions returned
+ * by control_step to the hardware.
+ */
+#define CONTROL_MAX_EVENTS 4	//most transitions a single step can produce
+
+//default thresholds of the policy (unit = %)
+#define CONTROL_BUZZER_SOC 45	//the buzzer is turned ON below this SOC while the battery is low
+#define CONTROL_CHARGE_START_SOC 90	//charging is started below this SOC when external power is available
+#define CONTROL_CHARGE_STOP_SOC 95	//charging is stopped at or above this SOC
+#define CONTROL_HYSTERESIS 0	//the load is connected again above the SOC limit plus this margin
+
+//battery sampling rate (unit = ms)
+#define CONTROL_FAST_PERIOD 10	//100Hz next to a threshold
+#define CONTROL_SLOW_PERIOD 1000	//1Hz when the battery is far from every threshold
+#define CONTROL_PERIOD_GROWTH 10	//factor the period grows by with every 1% of SOC away from the nearest threshold
+#define CONTROL_SAMPLES_AHEAD 4	//samples taken at least before a moving SOC can reach a threshold
+
+#define CONTROL_MAX_MILLIVOLTS 12000UL	//battery voltage at full scale of the ADC (unit = mV)
+#define CONTROL_CALIBRATION_SHIFT 16	//fraction bits of the calibration gain
+#define CONTROL_CALIBRATION_MIN_SPAN 100	//ADC counts needed between the two calibration points
+#define CONTROL_CALIBRATION_MAX_MILLIVOLTS (2 * CONTROL_MAX_MILLIVOLTS)	//highest calibration point, keeps the fit within 32 bits
+
+struct control_policy
+{
+	uint8_t soc_limit;	//the load is disconnected below this SOC (unit = %)
+	uint8_t buzzer_soc;
+	uint8_t charge_start_soc;
+	uint8_t charge_stop_soc;
+	uint8_t hysteresis;
+};
+
+struct control_state
+{
+	uint8_t load_on;
+	uint8_t charging;
+	uint8_t buzzer_on;
+	uint8_t countdown_in_progress;	//a count down owns the load, it is never switched ON by a step
+	uint8_t battery_low;	//set by the latest step
+};
+
+/* Load channels besides the main load. The table is kept in
+ * priority order, most critical first, and the less critical a
+ * channel the higher its cutoff margin should be so it is shed before
+ * the ones above it. The margins are above the SOC limit of the main
+ * load, so every channel is shed before it whatever limit the user
+ * sets, the thresholds stop at 100%. The outputs of all of the
+ * channels are a single bit mask, the bits of the port they are
+ * wired to.
+ */
+struct control_load
+{
+	uint8_t mask;	//output bit of the channel
+	uint8_t cutoff_margin;	//the channel is shed below the SOC limit + this (unit = %)
+	uint8_t reconnect_margin;	//and connected again at or above the SOC limit + this (unit = %)
+};
+
+//the load channels of the module, on PA5, PA6 and PA7
+#define LOAD_CHANNEL_COUNT 3
+extern const struct control_load gLoad_Channels[LOAD_CHANNEL_COUNT];
+
+/* Per unit correction of the ADC reading, found by a two point
+ * calibration against a voltmeter:
+ *   millivolts = (adc * gain + offset) >> CONTROL_CALIBRATION_SHIFT
+ */
+struct control_calibration
+{
+	int32_t gain;	//unit = mV / 2^CONTROL_CALIBRATION_SHIFT per ADC count
+	int32_t offset;	//unit = mV / 2^CONTROL_CALIBRATION_SHIFT
+};
+
+void control_policy_init(struct control_policy *policy, uint8_t soc_limit);
+uint8_t control_step(const struct control_policy *policy, struct control_state *state, uint8_t soc,
+		uint8_t external_power, uint8_t *events);
+uint8_t control_shed(const struct control_policy *policy, const struct control_load *loads, uint8_t count,
+		uint8_t outputs, uint8_t soc);
+uint8_t control_load_soc(const struct control_policy *policy, uint8_t margin);
+uint8_t control_soc(uint16_t millivolts);
+uint16_t control_sample_period(const struct control_policy *policy, const struct control_load *loads, uint8_t count,
+		uint8_t soc, uint8_t change, uint16_t elapsed);
+void control_calibration_init(struct control_calibration *calibration);
+uint8_t control_calibration_fit(struct control_calibration *calibration, uint16_t adc_low, uint16_t millivolts_low,
+		uint16_t adc_high, uint16_t millivolts_high);
+
+static inline uint16_t control_millivolts(uint16_t adc)
+{
+	//10 bit ADC reading to battery voltage (unit = mV)
+	return (uint32_t)adc * CONTROL_MAX_MILLIVOLTS / 1023;
+}
+
+static inline uint16_t control_calibrate(const struct control_calibration *calibration, uint16_t adc)
+{
+	//calibrated battery voltage of an ADC reading (unit = mV), a single multiply
+	int32_t scaled = (int32_t)adc * calibration->gain + calibration->offset;
+	return (scaled < 0) ? 0 : scaled >> CONTROL_CALIBRATION_SHIFT;
+}
+
+static inline uint16_t control_adc(uint16_t millivolts)
+{
+	//ADC reading of a battery voltage without calibration, the inverse of control_millivolts
+	uint32_t adc = ((uint32_t)millivolts * 1023 + CONTROL_MAX_MILLIVOLTS / 2) / CONTROL_MAX_MILLIVOLTS;
+	return (adc > 1023) ? 1023 : adc;
+}
+
+#endif /* CONTROL_H_ */
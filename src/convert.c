@@ -0,0 +1,82 @@
+/*
+ * convert.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "convert.h"
+
+
+uint16_t string_to_integer(char* string)
+{
+	/* This routine converts a NULL
+	 * terminated string to a 16 bit
+	 * unsigned integer
+	 */
+	uint16_t integer = 0;
+	int string_length = strlen(string);
+	for(int i = 0; i < string_length; ++i)
+	{
+		integer *= 10;
+		integer += string[i] - '0';
+	}
+	return integer;
+}
+
+
+#ifndef __AVR__
+/* this pointer is to be used by float_to_string
+ * routine to return values from memory when
+ * called. This is as to solve the problem of
+ * not being able to return an array by copying
+ * but rather the pointer to the array can be
+ * returned by copying. Returning pointer to
+ * local variables isn't viable since the variable's
+ * location in stack memory is cleaned after the
+ * routine is through with its execution
+ */
+char* gString = NULL;
+
+
+char* float_to_string(float value, char unit)
+{
+	/* This routine converts a float variable
+	 * to a NULL terminated string. It also
+	 * appends the unit character to the end
+	 * of the string.
+	 */
+	int real_part = (int)value;
+	uint8_t imag_part = (value - real_part) * 10;
+
+	gString = calloc(7, 1);	//allocate a zeroed 7 byte memory location to gString
+
+	uint8_t count = 0;
+
+	int dummy = real_part;
+	do
+	{
+		++count;
+		dummy /= 10;
+	}
+	while(dummy);
+	//reserve space for the . character as well as a single decimal character
+	count += 2;
+
+	if(unit != ' ')
+		gString[count] = unit;
+	gString[count + 1] = '\0';
+	gString[--count] = (imag_part % 10) + '0';
+	gString[--count] = '.';
+
+	do
+	{
+		gString[--count] = (real_part % 10) + '0';
+		real_part /= 10;
+	}
+	while(real_part);
+
+	return gString;
+}
+#endif
@@ -0,0 +1,28 @@
+/*
+ * convert.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef CONVERT_H_
+#define CONVERT_H_
+
+#include <stdint.h>
+
+/* String conversions used by the settings input. This file doesn't
+ * depend on the AVR headers so the routines can be benchmarked by
+ * the host tools.
+ */
+uint16_t string_to_integer(char* string);
+
+#ifndef __AVR__
+/* The screens print with lcd_printf_P, float_to_string is only
+ * kept in the host build so bench can compare against it.
+ */
+extern char* gString;	//last string returned by float_to_string, to be freed by the caller
+
+char* float_to_string(float value, char unit);
+#endif
+
+#endif /* CONVERT_H_ */
@@ -0,0 +1,18 @@
+/*
+ * crc.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef CRC_H_
+#define CRC_H_
+
+#include <stdint.h>
+
+#define CRC16_INIT 0xFFFF
+
+uint16_t crc16_update(uint16_t crc, uint8_t byte);
+uint16_t crc16(const uint8_t *data, uint16_t length);
+
+#endif /* CRC_H_ */
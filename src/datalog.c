@@ -0,0 +1,191 @@
+/*
+ * datalog.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include <string.h>
+#include "defs.h"
+#include "datalog.h"
+
+/* Two page buffers: one is being filled with samples while the
+ * other one is owned by the flash writer. A page that fills up
+ * before the other one has been written waits, the samples taken
+ * meanwhile are counted and dropped.
+ */
+static uint8_t pages[2][DATALOG_PAGE_SIZE];
+static uint8_t fill = 0;	//page being filled
+static uint8_t fill_length = 0;	//bytes used in the page being filled, 0 before its first sample
+static uint8_t full = FALSE;	//the page being filled is waiting for the flash writer
+
+static uint32_t page_next = 0;	//next flash page to be written
+static uint32_t page_sequence = 0;	//sequence number of the next flash page
+static uint16_t sample_period;
+
+static uint32_t last_time;	//last sample written to the page being filled
+static uint16_t last_adc;
+static uint8_t last_flags;
+static uint32_t dropped = 0;
+
+
+static void put_u32(uint8_t *p, uint32_t value)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+	p[2] = value >> 16;
+	p[3] = value >> 24;
+	return;
+}
+
+
+static uint32_t read_sequence(uint32_t index)
+{
+	uint8_t p[4];
+	while(!flash_read(index * DATALOG_PAGE_SIZE, p, sizeof(p)));
+	return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+void datalog_init(uint16_t period)
+{
+	/* Finds the next page to be written with a binary search
+	 * over the sequence numbers. The pages written since the
+	 * last wrap around continue the sequence of page 0, the first
+	 * page that doesn't is either older or erased.
+	 */
+	flash_init();
+	sample_period = period;
+	uint32_t first = read_sequence(0);
+	if(first == DATALOG_ERASED)
+		return;	//blank flash
+
+	uint32_t low = 1, high = DATALOG_PAGE_COUNT;
+	while(low < high)
+	{
+		uint32_t middle = low + (high - low) / 2;
+		if(read_sequence(middle) == first + middle)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	page_next = (low == DATALOG_PAGE_COUNT) ? 0 : low;
+	page_sequence = first + low;
+	return;
+}
+
+
+static uint8_t datalog_flush(void)
+{
+	//hands the page being filled over to the flash writer
+	if(flash_busy())
+		return FALSE;
+	uint8_t *page = pages[fill];
+	memset(page + fill_length, DATALOG_END, DATALOG_PAGE_SIZE - fill_length);
+	put_u32(page, page_sequence);
+	flash_program(page_next * DATALOG_PAGE_SIZE, page, DATALOG_PAGE_SIZE);
+
+	++page_sequence;
+	if(++page_next == DATALOG_PAGE_COUNT)
+		page_next = 0;
+	fill ^= 1;
+	fill_length = 0;
+	full = FALSE;
+	return TRUE;
+}
+
+
+void datalog_add(uint32_t time, uint16_t adc, uint8_t flags)
+{
+	/* Appends a sample to the page being filled. When it doesn't
+	 * fit, the page is handed over to the flash writer and the
+	 * sample starts the next one with a header of its own.
+	 */
+	if(full && !datalog_flush())
+	{
+		++dropped;
+		return;
+	}
+
+	uint8_t record[6];
+	uint8_t length = 0;
+	uint8_t next_page = FALSE;
+	if(fill_length)
+	{
+		uint32_t late = (time - last_time + sample_period / 2) / sample_period;
+		if(late > 0x10000)
+			next_page = TRUE;	//too late for a gap record, the header of a new page has the time
+		else if(late > 1)
+		{
+			record[length++] = DATALOG_GAP;
+			record[length++] = late - 1;
+			record[length++] = (late - 1) >> 8;
+		}
+		int16_t delta = (int16_t)adc - (int16_t)last_adc;
+		if(flags == last_flags && delta >= -64 && delta <= 63)
+			record[length++] = delta & 0x7F;
+		else
+		{
+			record[length++] = DATALOG_FULL | ((adc >> 8) & 0x03);
+			record[length++] = adc;
+			record[length++] = flags;
+		}
+		if(next_page || fill_length + length > DATALOG_PAGE_SIZE)
+		{
+			full = TRUE;
+			if(!datalog_flush())
+			{
+				++dropped;
+				return;
+			}
+		}
+	}
+
+	uint8_t *page = pages[fill];
+	if(!fill_length)
+	{
+		//the sequence number is only known once the page is handed over
+		put_u32(page + 4, time);
+		page[8] = sample_period;
+		page[9] = sample_period >> 8;
+		fill_length = DATALOG_HEADER_SIZE;
+		record[0] = DATALOG_FULL | ((adc >> 8) & 0x03);
+		record[1] = adc;
+		record[2] = flags;
+		length = 3;
+	}
+	memcpy(page + fill_length, record, length);
+	fill_length += length;
+	last_time = time;
+	last_adc = adc;
+	last_flags = flags;
+	return;
+}
+
+
+void datalog_poll(void)
+{
+	//moves the flash write on and hands a full page over once the flash is free
+	flash_poll();
+	if(full)
+		datalog_flush();
+	return;
+}
+
+
+uint8_t datalog_sync(void)
+{
+	/* Hands the page being filled over even though it isn't
+	 * full, e.g. before the power is removed on purpose. FALSE
+	 * is returned while the flash is still busy with the page
+	 * before.
+	 */
+	if(!fill_length)
+		return TRUE;
+	return datalog_flush();
+}
+
+
+uint32_t datalog_dropped(void)
+{
+	return dropped;
+}
@@ -0,0 +1,49 @@
+/*
+ * datalog.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef DATALOG_H_
+#define DATALOG_H_
+
+#include <stdint.h>
+#include "flash.h"
+
+/* Battery history kept in the serial flash: a sample of the raw
+ * battery ADC reading and the status flags every DATALOG_PERIOD ms.
+ * The samples are packed into pages of DATALOG_PAGE_SIZE bytes in
+ * RAM, a full page is written to flash while the next one fills
+ * up. The pages are written round robin over the whole flash, which
+ * holds about 5 weeks of samples at one per second.
+ *
+ * A page starts with a header, all numbers are little endian:
+ *   uint32 sequence  number of the page since the flash was erased
+ *   uint32 time      time of the first sample (unit = ms since power up)
+ *   uint16 period    time between two samples (unit = ms)
+ * followed by the records of the samples, each one period after the
+ * one before:
+ *   0ddddddd                     ADC reading changed by d (-64 to 63), same flags
+ *   100000hh llllllll ffffffff   ADC reading hhllllllll and flags f
+ *   11000000 llllllll hhhhhhhh   the next sample is late by this many periods
+ *   11111111                     end of the page
+ * The first record of a page is always a full one. A page that is
+ * still being filled when the power goes off is lost.
+ */
+#define DATALOG_PAGE_SIZE 64
+#define DATALOG_HEADER_SIZE 10
+#define DATALOG_PAGE_COUNT (FLASH_SIZE / DATALOG_PAGE_SIZE)
+#define DATALOG_DELTA_MASK 0x80
+#define DATALOG_FULL 0x80
+#define DATALOG_GAP 0xC0
+#define DATALOG_END 0xFF
+#define DATALOG_ERASED 0xFFFFFFFFUL	//sequence of a page that hasn't been written
+
+void datalog_init(uint16_t period);
+void datalog_add(uint32_t time, uint16_t adc, uint8_t flags);
+void datalog_poll(void);
+uint8_t datalog_sync(void);
+uint32_t datalog_dropped(void);
+
+#endif /* DATALOG_H_ */
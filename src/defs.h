@@ -21,6 +21,13 @@
 #define FALSE LOW	//define our own false variable since C doesn't come with one by default
 
 #define BATTERY_LEVEL PA2	//Analog read pin for detecting voltage battery level
+/* Define ADC_INTERNAL_REFERENCE to measure against the internal 2.56V
+ * reference instead of AVcc, which doesn't drift with the supply. The
+ * battery divider must then bring 12V down to 2.56V instead of 5V and
+ * the unit has to be calibrated (settings option 3).
+ */
+//#define ADC_INTERNAL_REFERENCE
+#define CALIBRATION_SAMPLES 16	//ADC readings averaged for a calibration point, a power of two
 #define BUZZER_ON PORTA |= (1 << PA3)	//Turn ON buzzer
 #define BUZZER_OFF PORTA &= ~(1 << PA3) 	//Turn OFF buzzer
 #define EXTERNAL_POWER_AVAILABLE PINC & (1 << PC4)	//input pin used to check the availability of external power supply
@@ -28,81 +35,78 @@
 #define BATTERY_CHARGE_OFF PORTA &= ~(1 << PA1)	//Disable battery charging from external power supply
 #define LOAD_SUPPLY_ON PORTA |= (1 << PA0)	//Enable power supply to a connected load
 #define LOAD_SUPPLY_OFF PORTA &= ~(1 << PA0) //Disable power supply to a connected load
+#define LOAD_PORT PORTA	//the main load and the load channels are on this port
+#define LOAD_CHANNEL_MASK ((1 << PA5) | (1 << PA6) | (1 << PA7))	//outputs of the load channels, see gLoad_Channels in control.c
 #define ENABLE_LED(a) PORTC |= (1 << a)	//enable or turn ON a LED bulb connected to pin a
 #define DISABLE_LED(a) PORTC &= ~(1 << a)	//disable or turn OFF a LED bulb connected to pin a
 
 
 /*************** MATRIX KEYPAD MAPPING START **********************/
 
+/* The keypad port is fixed at compile time and every call site
+ * passes a constant pin, so each of the macros below compiles to a
+ * single sbi, cbi or sbic/sbis instruction.
+ */
+#define MATRIX_KEYPAD_PORT PORTB	//the rows are driven from this port
+#define MATRIX_KEYPAD_PIN PINB	//and the columns are read back from this one
+
 //this enables a PIN by sending a HIGH signal to it
-#define MATRIX_KEYPAD_OUTPUT_ENABLE(a) PORTB |= (1 << a)
+#define MATRIX_KEYPAD_OUTPUT_ENABLE(a) (MATRIX_KEYPAD_PORT |= (1 << (a)))
 
 //this disables a PIN by sending a LOW signal to it
-#define MATRIX_KEYPAD_OUTPUT_DISABLE(b) PORTB &= ~(1 << b)
+#define MATRIX_KEYPAD_OUTPUT_DISABLE(b) (MATRIX_KEYPAD_PORT &= ~(1 << (b)))
 
 //this is used to scan a PIN register to indicate when a the pin has been set HIGH from user interaction
-#define MATRIX_KEYPAD_INPUT_ENABLED(c) PINB & (1 << c)
+#define MATRIX_KEYPAD_INPUT_ENABLED(c) (MATRIX_KEYPAD_PIN & (1 << (c)))
 
 /************** MATRIX KEYPAD MAPPING ENG *************************/
 
 #define DEFAULT_SOC_VALUE 50	//default SOC value to be used by the module (unit = %)
 #define BATTERY_MAX_VOLTAGE 12.0	//defines the maximum voltage of the battery in use (unit = V)
+#define BATTERY_MAX_MILLIVOLTS 12000UL	//integer equivalent of BATTERY_MAX_VOLTAGE (unit = mV)
+#define LOAD_NOMINAL_CURRENT 1000	//estimated current drawn by the connected load, used for energy accounting (unit = mA)
 
+#define TELEMETRY_BAUD_RATE 38400UL	//baud rate of the telemetry stream on the USART (PD0/PD1)
+#define TELEMETRY_PERIOD 1000	//time between two telemetry snapshot frames (unit = ms)
 
-#define LCDInit() {\
-	lcd_init();\
-	lcd_on();\
-	lcd_disable_blinking();\
-	lcd_disable_cursor();\
-	lcd_disable_autoscroll();\
-}
-
-#define LCDClear() lcd_clear()
-
-#define LCDData(b) lcd_write(b)
-
-#define LCDWriteStringXY(x, y, msg) {\
- lcd_set_cursor(x, y);\
- lcd_puts(msg);\
-}
-
-#define LCDWriteIntXY(x, y, val, fl) {\
- lcd_set_cursor(x, y);\
- LCDWriteInt(val,fl);\
-}
-
-void LCDWriteInt(int val,unsigned int field_length)
-{
-	/***************************************************************
-	This function writes a integer type value to LCD module
-
-	Arguments:
-	1)int val	: Value to print
-
-	2)unsigned int field_length :total length of field in which the value is printed
-	must be between 1-5 if it is -1 the field length is no of digits in the val
-
-	****************************************************************/
-
-	char str[5] = {0, 0, 0, 0, 0};
-	int i = 4, j = 0;
-	while(val)
-	{
-		str[i] = val % 10;
-		val = val / 10;
-		i--;
-	}
-	if(field_length == -1)
-		while(str[j] == 0) j++;
-	else
-		j = 5 - field_length;
-
-	if(val < 0) LCDData('-');
-	for(i = j; i < 5; i++)
-	{
-		LCDData(48 + str[i]);
-	}
-}
+/* Define MODBUS_SLAVE to serve Modbus RTU requests on an RS-485 bus
+ * instead of streaming telemetry frames. Both use the only USART and
+ * a shared bus can't carry unsolicited frames.
+ */
+//#define MODBUS_SLAVE
+#define MODBUS_BAUD_RATE 19200UL	//baud rate of the Modbus RTU slave
+#define MODBUS_ADDRESS 1	//default Modbus slave address of the module
+#define RS485_TRANSMIT PORTB |= (1 << PB7)	//drive the RS-485 bus (DE/RE on PB7)
+#define RS485_RECEIVE PORTB &= ~(1 << PB7)	//release the RS-485 bus
+#if defined(MODBUS_SLAVE) && defined(LCD_EN2)
+#error "LCD_EN2 takes PB7, the RS-485 driver enable of MODBUS_SLAVE"
+#endif
+
+/* Define PROFILING to build the cycle count probes in prof.h into
+ * the firmware. The results are shown on an extra LCD page and
+ * sent over the telemetry link on request.
+ */
+//#define PROFILING
+
+/* Serial flash of the data logger, driven by software since the SPI
+ * pins are taken by the keypad and the RS-485 driver
+ */
+#define FLASH_SELECT PORTA &= ~(1 << PA4)	//chip select of the flash (active low)
+#define FLASH_DESELECT PORTA |= (1 << PA4)
+#define FLASH_SCK_HIGH PORTC |= (1 << PC5)
+#define FLASH_SCK_LOW PORTC &= ~(1 << PC5)
+#define FLASH_MOSI_HIGH PORTC |= (1 << PC6)
+#define FLASH_MOSI_LOW PORTC &= ~(1 << PC6)
+#define FLASH_MISO (PINC & (1 << PC7))	//input pin
+#define DATALOG_PERIOD 1000	//time between two samples of the data logger (unit = ms)
+
+#define STATS_PAGE_PERIOD 4	//the statistics page is shown once every this many display periods
+#define DISPLAY_PERIOD 1000	//time between two refreshes of the battery state on the LCD (unit = ms)
+#define LOW_PAGE_TIME 300	//time the BATTERY LOW page is left up (unit = ms)
+#define CHARGING_PAGE_TIME 200	//time the BATT CHARGING page is left up (unit = ms)
+#define STATS_PAGE_TIME 1000	//time the statistics and profiling pages are left up (unit = ms)
+#define DISPLAY_COLUMNS 16	//geometry of the display: 16x2, 20x4, 40x2 or 40x4 (40x4 needs LCD_EN2 in lcd.h)
+#define DISPLAY_ROWS 2
 
 
 #endif /* DEFS_H_ */
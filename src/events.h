@@ -0,0 +1,27 @@
+/*
+ * events.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef EVENTS_H_
+#define EVENTS_H_
+
+//control event codes shared by the telemetry stream and the host tools
+#define EVENT_BOOT 0x01	//the module has been powered up
+#define EVENT_LOAD_ON 0x02	//power to the connected load has been enabled
+#define EVENT_LOAD_OFF 0x03	//power to the connected load has been disabled because of a low battery
+#define EVENT_CHARGE_ON 0x04	//battery charging from the external power supply has been started
+#define EVENT_CHARGE_OFF 0x05	//battery charging from the external power supply has been stopped
+#define EVENT_BUZZER_ON 0x06	//the low battery buzzer has been turned ON
+#define EVENT_BUZZER_OFF 0x07	//the low battery buzzer has been turned OFF
+#define EVENT_COUNTDOWN_START 0x08	//a count down has been started by the user
+#define EVENT_COUNTDOWN_END 0x09	//a count down has expired or has been terminated by a low battery
+#define EVENT_SOC_LIMIT_SET 0x0A	//the SOC limit has been changed by the user
+#define EVENT_WARM_RESTART 0x0B	//the module has resumed its control state after a watchdog, brown-out or external reset
+#define EVENT_LOAD_SHED 0x0C	//a non-critical load channel has been disconnected to save the battery
+#define EVENT_LOAD_RESTORE 0x0D	//a non-critical load channel has been connected again
+#define EVENT_CALIBRATED 0x0E	//a new ADC calibration has been saved
+
+#endif /* EVENTS_H_ */
@@ -0,0 +1,159 @@
+/*
+ * evlog.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include "defs.h"
+#include "evlog.h"
+#include "nvm.h"
+
+#define EVLOG_RAM_MASK (EVLOG_RAM_SIZE - 1)
+#define EVLOG_PAGE_SIZE (EVLOG_PAGE_RECORDS * sizeof(struct evlog_record))
+#define EVLOG_PAGE_COUNT (NVM_EVLOG_SIZE / EVLOG_PAGE_SIZE)
+#define EVLOG_EMPTY 0xFF
+
+#if EVLOG_RAM_SIZE & EVLOG_RAM_MASK
+#error "EVLOG_RAM_SIZE must be a power of two"
+#endif
+
+/* Events are written into a RAM ring and spilled to EEPROM in
+ * pages of EVLOG_PAGE_RECORDS records. The pages are written round
+ * robin over the whole EEPROM area so the wear is spread evenly.
+ */
+static struct evlog_record ring[EVLOG_RAM_SIZE];
+static uint8_t ring_head = 0;	//next record to be written
+static uint8_t ring_pending = 0;	//records in the ring not yet spilled to EEPROM
+
+static struct evlog_record page[EVLOG_PAGE_RECORDS];	//page being written, owned by the EEPROM writer until it is done
+static uint8_t page_next = 0;	//next EEPROM page to be written
+static uint8_t page_sequence = 0;	//sequence number of the next EEPROM page
+
+static uint8_t dumping = FALSE;	//spilling is held back while a dump is in progress
+static uint8_t dump_page;	//EEPROM pages already dumped
+static uint8_t dump_ram;	//RAM records already dumped
+
+
+static inline uint16_t page_address(uint8_t index)
+{
+	return NVM_EVLOG_BASE + (uint16_t)index * EVLOG_PAGE_SIZE;
+}
+
+
+void evlog_init(void)
+{
+	/* Finds the newest page in a single pass over the first
+	 * record of every page. The first page whose sequence number
+	 * doesn't follow the one of the page before it is the oldest
+	 * page and the next one to be overwritten.
+	 */
+	uint8_t previous_sequence = 0;
+	page_next = 0;
+	page_sequence = 0;
+
+	for(uint8_t i = 0; i < EVLOG_PAGE_COUNT; ++i)
+	{
+		struct evlog_record record;
+		nvm_read(page_address(i), &record, sizeof(record));
+		if(i > 0 && (record.code == EVLOG_EMPTY || record.sequence != (uint8_t)(previous_sequence + 1)))
+		{
+			page_next = i;
+			page_sequence = previous_sequence + 1;
+			return;
+		}
+		if(record.code == EVLOG_EMPTY)
+			return;	//blank EEPROM
+		previous_sequence = record.sequence;
+	}
+
+	//every page follows its predecessor, the last page was the newest one
+	page_sequence = previous_sequence + 1;
+	return;
+}
+
+
+void evlog_add(uint32_t time, uint8_t code, uint8_t soc, uint8_t state)
+{
+	/* Appends an event to the RAM ring. When the ring is full
+	 * the oldest record that hasn't been spilled is overwritten.
+	 */
+	struct evlog_record *record = &ring[ring_head];
+	record->time = time;
+	record->code = code;
+	record->soc = soc;
+	record->state = state;
+	ring_head = (ring_head + 1) & EVLOG_RAM_MASK;
+	if(ring_pending < EVLOG_RAM_SIZE)
+		++ring_pending;
+	return;
+}
+
+
+void evlog_poll(void)
+{
+	/* Spills a page of records to EEPROM once enough of them
+	 * are pending and the previous page has been written.
+	 * Called from the background tasks of the main loop.
+	 */
+	if(dumping || ring_pending < EVLOG_PAGE_RECORDS || nvm_busy())
+		return;
+
+	uint8_t index = (ring_head - ring_pending) & EVLOG_RAM_MASK;
+	for(uint8_t i = 0; i < EVLOG_PAGE_RECORDS; ++i)
+	{
+		page[i] = ring[index];
+		page[i].sequence = page_sequence;
+		index = (index + 1) & EVLOG_RAM_MASK;
+	}
+
+	if(!nvm_write(page_address(page_next), page, EVLOG_PAGE_SIZE))
+		return;
+	ring_pending -= EVLOG_PAGE_RECORDS;
+	++page_sequence;
+	if(++page_next == EVLOG_PAGE_COUNT)
+		page_next = 0;
+	return;
+}
+
+
+void evlog_dump_start(void)
+{
+	dumping = TRUE;
+	dump_page = 0;
+	dump_ram = 0;
+	return;
+}
+
+
+uint8_t evlog_dump_next(struct evlog_record *records)
+{
+	/* Returns the next batch of up to EVLOG_PAGE_RECORDS
+	 * records of a dump, oldest first: the EEPROM pages and
+	 * then the records still held in RAM. 0 is returned once
+	 * the dump is complete and EVLOG_DUMP_WAIT while the last
+	 * page is still being written to EEPROM.
+	 */
+	while(dump_page < EVLOG_PAGE_COUNT)
+	{
+		uint8_t index = page_next + dump_page;
+		if(index >= EVLOG_PAGE_COUNT)
+			index -= EVLOG_PAGE_COUNT;
+		if(!nvm_read(page_address(index), records, EVLOG_PAGE_SIZE))
+			return EVLOG_DUMP_WAIT;
+		++dump_page;
+		if(records[0].code != EVLOG_EMPTY)
+			return EVLOG_PAGE_RECORDS;
+	}
+
+	uint8_t count = 0;
+	while(dump_ram < ring_pending && count < EVLOG_PAGE_RECORDS)
+	{
+		records[count] = ring[(ring_head - ring_pending + dump_ram) & EVLOG_RAM_MASK];
+		records[count].sequence = page_sequence;
+		++dump_ram;
+		++count;
+	}
+	if(!count)
+		dumping = FALSE;
+	return count;
+}
@@ -0,0 +1,36 @@
+/*
+ * evlog.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef EVLOG_H_
+#define EVLOG_H_
+
+#include <stdint.h>
+
+#define EVLOG_RAM_SIZE 16	//records held in RAM, must be a power of two
+#define EVLOG_PAGE_RECORDS 4	//records spilled to EEPROM in a single write
+#define EVLOG_DUMP_WAIT 0xFF	//returned by evlog_dump_next while the EEPROM is busy
+
+/* A packed event record. The sequence number is the number of the
+ * EEPROM page the record was spilled with, it is used to find the
+ * newest page again after a reset.
+ */
+struct evlog_record
+{
+	uint32_t time;	//time stamp of the event (unit = ms since power up)
+	uint8_t code;	//one of the EVENT_ codes in events.h, 0xFF marks an empty record
+	uint8_t soc;	//SOC of the battery when the event occurred (unit = %)
+	uint8_t state;	//status flags when the event occurred, same bits as the telemetry snapshot flags
+	uint8_t sequence;
+};
+
+void evlog_init(void);
+void evlog_add(uint32_t time, uint8_t code, uint8_t soc, uint8_t state);
+void evlog_poll(void);
+void evlog_dump_start(void);
+uint8_t evlog_dump_next(struct evlog_record *records);
+
+#endif /* EVLOG_H_ */
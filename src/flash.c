@@ -0,0 +1,173 @@
+/*
+ * flash.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include <avr/io.h>
+#include "defs.h"
+#include "flash.h"
+
+#define FLASH_WRITE_ENABLE 0x06
+#define FLASH_READ_STATUS 0x05
+#define FLASH_READ_DATA 0x03
+#define FLASH_PAGE_PROGRAM 0x02
+#define FLASH_SECTOR_ERASE 0x20
+#define FLASH_STATUS_BUSY 0x01
+
+/* The SPI pins of the ATmega32 (PB4 to PB7) are taken by the
+ * keypad and the RS-485 driver so the flash is driven by software
+ * on the pins given in defs.h, in SPI mode 0 at about 1MHz.
+ */
+enum flash_state
+{
+	FLASH_IDLE,
+	FLASH_ERASING,	//waiting for the sector erase to finish
+	FLASH_PROGRAMMING,	//sending the data of a page program, chip select held low
+	FLASH_WRITING	//waiting for the page program to finish
+};
+
+static uint8_t state = FLASH_IDLE;
+static uint32_t job_address;
+static const uint8_t *job_data;
+static uint16_t job_length;
+
+
+static uint8_t spi_transfer(uint8_t out)
+{
+	uint8_t in = 0;
+	for(uint8_t bit = 0; bit < 8; ++bit)
+	{
+		if(out & 0x80)
+			FLASH_MOSI_HIGH;
+		else
+			FLASH_MOSI_LOW;
+		out <<= 1;
+		FLASH_SCK_HIGH;
+		in = (in << 1) | (FLASH_MISO ? 1 : 0);
+		FLASH_SCK_LOW;
+	}
+	return in;
+}
+
+
+static void flash_command(uint8_t command, uint32_t address)
+{
+	//starts a command with a 24 bit address, chip select is left low
+	FLASH_SELECT;
+	spi_transfer(command);
+	spi_transfer(address >> 16);
+	spi_transfer(address >> 8);
+	spi_transfer(address);
+	return;
+}
+
+
+static void flash_write_enable(void)
+{
+	FLASH_SELECT;
+	spi_transfer(FLASH_WRITE_ENABLE);
+	FLASH_DESELECT;
+	return;
+}
+
+
+static uint8_t flash_status_busy(void)
+{
+	FLASH_SELECT;
+	spi_transfer(FLASH_READ_STATUS);
+	uint8_t status = spi_transfer(0);
+	FLASH_DESELECT;
+	return status & FLASH_STATUS_BUSY;
+}
+
+
+void flash_init(void)
+{
+	FLASH_DESELECT;
+	FLASH_SCK_LOW;
+	return;
+}
+
+
+uint8_t flash_busy(void)
+{
+	return state != FLASH_IDLE;
+}
+
+
+uint8_t flash_program(uint32_t address, const uint8_t *data, uint16_t length)
+{
+	/* Starts writing length bytes at address, within a single
+	 * flash page. A write to the start of a sector erases the
+	 * sector first. FALSE is returned while a write is still
+	 * in progress.
+	 */
+	if(state != FLASH_IDLE)
+		return FALSE;
+	job_address = address;
+	job_data = data;
+	job_length = length;
+	flash_write_enable();
+	if(address % FLASH_SECTOR_SIZE == 0)
+	{
+		flash_command(FLASH_SECTOR_ERASE, address);
+		FLASH_DESELECT;
+		state = FLASH_ERASING;
+	}
+	else
+	{
+		flash_command(FLASH_PAGE_PROGRAM, address);
+		state = FLASH_PROGRAMMING;
+	}
+	return TRUE;
+}
+
+
+void flash_poll(void)
+{
+	//moves the write in progress on, called from the background tasks
+	switch(state)
+	{
+		case FLASH_ERASING: {
+			if(flash_status_busy())
+				break;
+			flash_write_enable();
+			flash_command(FLASH_PAGE_PROGRAM, job_address);
+			state = FLASH_PROGRAMMING;
+			break;
+		}
+		case FLASH_PROGRAMMING: {
+			uint8_t count = (job_length < FLASH_CHUNK) ? job_length : FLASH_CHUNK;
+			for(uint8_t i = 0; i < count; ++i)
+				spi_transfer(*job_data++);
+			job_length -= count;
+			if(!job_length)
+			{
+				FLASH_DESELECT;	//the flash starts programming the page now
+				state = FLASH_WRITING;
+			}
+			break;
+		}
+		case FLASH_WRITING: {
+			if(!flash_status_busy())
+				state = FLASH_IDLE;
+			break;
+		}
+	}
+	return;
+}
+
+
+uint8_t flash_read(uint32_t address, void *data, uint16_t length)
+{
+	//reads share the bus with a write, FALSE is returned while one is in progress
+	if(state != FLASH_IDLE)
+		return FALSE;
+	flash_command(FLASH_READ_DATA, address);
+	uint8_t *bytes = data;
+	while(length--)
+		*bytes++ = spi_transfer(0);
+	FLASH_DESELECT;
+	return TRUE;
+}
@@ -0,0 +1,34 @@
+/*
+ * flash.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef FLASH_H_
+#define FLASH_H_
+
+#include <stdint.h>
+
+/* Serial NOR flash (W25Q32 or compatible, 4MB) used by the data
+ * logger. flash.c drives it on the AVR, tools/host/flash_file.c
+ * keeps the same contents in an image file on the host.
+ *
+ * Writes are asynchronous: flash_program starts a write and every
+ * call to flash_poll moves it on by at most FLASH_CHUNK bytes or a
+ * single status read, so the main loop never waits for an erase
+ * or a page program. The data is not copied, it must be left
+ * untouched until flash_busy returns FALSE.
+ */
+#define FLASH_SIZE 0x400000UL
+#define FLASH_SECTOR_SIZE 4096	//smallest erasable unit
+#define FLASH_PAGE_SIZE 256	//a program must not cross a page boundary
+#define FLASH_CHUNK 16	//bytes sent by a single call to flash_poll
+
+void flash_init(void);
+uint8_t flash_busy(void);
+uint8_t flash_program(uint32_t address, const uint8_t *data, uint16_t length);
+void flash_poll(void);
+uint8_t flash_read(uint32_t address, void *data, uint16_t length);
+
+#endif /* FLASH_H_ */
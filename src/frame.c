@@ -0,0 +1,128 @@
+/*
+ * frame.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include "frame.h"
+
+//states of the frame decoder
+#define DECODE_SYNC1 0
+#define DECODE_SYNC2 1
+#define DECODE_TYPE 2
+#define DECODE_LENGTH 3
+#define DECODE_PAYLOAD 4
+#define DECODE_CHECK_A 5
+#define DECODE_CHECK_B 6
+
+
+static inline void fletcher_update(uint16_t *sum1, uint16_t *sum2, uint8_t byte)
+{
+	//modulo 255 by conditional subtraction, avoids a division on the AVR
+	*sum1 += byte;
+	if(*sum1 >= 255)
+		*sum1 -= 255;
+	*sum2 += *sum1;
+	if(*sum2 >= 255)
+		*sum2 -= 255;
+}
+
+
+uint16_t frame_checksum(uint8_t type, const uint8_t *payload, uint8_t length)
+{
+	/* Fletcher-16 checksum over the type, the length and
+	 * the payload of a frame. The low byte holds the first
+	 * check byte and the high byte holds the second one.
+	 */
+	uint16_t sum1 = 0, sum2 = 0;
+	fletcher_update(&sum1, &sum2, type);
+	fletcher_update(&sum1, &sum2, length);
+	for(uint8_t i = 0; i < length; ++i)
+		fletcher_update(&sum1, &sum2, payload[i]);
+	return sum1 | (sum2 << 8);
+}
+
+
+uint8_t frame_encode(uint8_t type, const uint8_t *payload, uint8_t length, uint8_t *frame)
+{
+	/* This routine wraps a payload into a frame. The frame
+	 * buffer must hold at least length + FRAME_OVERHEAD bytes.
+	 * The total length of the frame is returned.
+	 */
+	uint16_t check = frame_checksum(type, payload, length);
+	frame[0] = FRAME_SYNC1;
+	frame[1] = FRAME_SYNC2;
+	frame[2] = type;
+	frame[3] = length;
+	for(uint8_t i = 0; i < length; ++i)
+		frame[4 + i] = payload[i];
+	frame_put16(frame + 4 + length, check);
+	return length + FRAME_OVERHEAD;
+}
+
+
+void frame_decoder_init(struct frame_decoder *decoder)
+{
+	decoder->state = DECODE_SYNC1;
+	return;
+}
+
+
+uint8_t frame_decode(struct frame_decoder *decoder, uint8_t byte)
+{
+	/* This routine feeds a single received byte to the
+	 * decoder. It returns TRUE once a complete frame with a
+	 * valid checksum has been received, the frame can then be
+	 * read from the type, length and payload fields. Corrupted
+	 * frames are dropped and the decoder resynchronises on the
+	 * next sync sequence.
+	 */
+	switch(decoder->state)
+	{
+		case DECODE_SYNC1: {
+			if(byte == FRAME_SYNC1)
+				decoder->state = DECODE_SYNC2;
+			break;
+		}
+		case DECODE_SYNC2: {
+			if(byte == FRAME_SYNC2)
+				decoder->state = DECODE_TYPE;
+			else if(byte != FRAME_SYNC1)
+				decoder->state = DECODE_SYNC1;
+			break;
+		}
+		case DECODE_TYPE: {
+			decoder->type = byte;
+			decoder->state = DECODE_LENGTH;
+			break;
+		}
+		case DECODE_LENGTH: {
+			decoder->length = byte;
+			decoder->index = 0;
+			if(byte > FRAME_MAX_PAYLOAD)
+				decoder->state = DECODE_SYNC1;
+			else
+				decoder->state = byte ? DECODE_PAYLOAD : DECODE_CHECK_A;
+			break;
+		}
+		case DECODE_PAYLOAD: {
+			decoder->payload[decoder->index++] = byte;
+			if(decoder->index == decoder->length)
+				decoder->state = DECODE_CHECK_A;
+			break;
+		}
+		case DECODE_CHECK_A: {
+			decoder->check_a = byte;
+			decoder->state = DECODE_CHECK_B;
+			break;
+		}
+		case DECODE_CHECK_B: {
+			decoder->state = DECODE_SYNC1;
+			uint16_t check = frame_checksum(decoder->type, decoder->payload, decoder->length);
+			if(check == (decoder->check_a | ((uint16_t)byte << 8)))
+				return 1;
+			break;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * frame.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include <stdint.h>
+
+/* Compact binary framing used by the telemetry stream:
+ *
+ *   SYNC1 SYNC2 TYPE LENGTH PAYLOAD[LENGTH] CHECK_A CHECK_B
+ *
+ * The check bytes are a Fletcher-16 checksum computed over
+ * TYPE, LENGTH and PAYLOAD. All multi-byte payload fields are
+ * little endian. This file doesn't depend on the AVR headers
+ * so it can be shared with the host tools.
+ */
+#define FRAME_SYNC1 0xA5
+#define FRAME_SYNC2 0x5A
+#define FRAME_OVERHEAD 6	//number of bytes added to the payload by the framing
+#define FRAME_MAX_PAYLOAD 48
+
+//frame types
+#define FRAME_SNAPSHOT 0x01	//periodic measurement snapshot
+#define FRAME_EVENT 0x02	//control event
+#define FRAME_STATS 0x03	//running battery statistics
+#define FRAME_EVLOG 0x04	//up to 4 event log records of a dump, 8 bytes each
+#define FRAME_EVLOG_END 0x05	//end of an event log dump, carries the number of records sent
+#define FRAME_BOOT 0x06	//sent once after power up
+#define FRAME_PROFILE 0x07	//results of a single profiling probe
+#define FRAME_MEMORY 0x08	//SRAM high-water marks, sent along with the statistics
+
+//payload lengths of the frame types above
+#define FRAME_SNAPSHOT_LENGTH 11
+#define FRAME_EVENT_LENGTH 6
+#define FRAME_STATS_LENGTH 22
+#define FRAME_EVLOG_RECORD_LENGTH 8
+#define FRAME_EVLOG_END_LENGTH 2
+#define FRAME_BOOT_LENGTH 3
+#define FRAME_PROFILE_LENGTH 48
+#define FRAME_MEMORY_LENGTH 8
+
+//bits of the reset cause carried by a boot frame, the low bits are the MCUCSR reset flags
+#define FRAME_BOOT_WARM 0x80	//the control state has been resumed from RAM
+
+//commands accepted on the telemetry link
+#define FRAME_COMMAND_DUMP 'D'	//dump the event log
+#define FRAME_COMMAND_PROFILE 'P'	//send the results of every profiling probe
+#define FRAME_COMMAND_PROFILE_RESET 'R'	//clear the results of the profiling probes
+
+//status flags carried by a snapshot frame
+#define FRAME_FLAG_LOAD_ON 0x01
+#define FRAME_FLAG_CHARGING 0x02
+#define FRAME_FLAG_BUZZER_ON 0x04
+#define FRAME_FLAG_EXTERNAL_POWER 0x08
+#define FRAME_FLAG_COUNTDOWN 0x10
+
+struct frame_decoder
+{
+	uint8_t state;
+	uint8_t type;
+	uint8_t length;
+	uint8_t index;
+	uint8_t payload[FRAME_MAX_PAYLOAD];
+	uint8_t check_a;
+};
+
+uint16_t frame_checksum(uint8_t type, const uint8_t *payload, uint8_t length);
+uint8_t frame_encode(uint8_t type, const uint8_t *payload, uint8_t length, uint8_t *frame);
+void frame_decoder_init(struct frame_decoder *decoder);
+uint8_t frame_decode(struct frame_decoder *decoder, uint8_t byte);
+
+static inline uint8_t* frame_put16(uint8_t *p, uint16_t value)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+	return p + 2;
+}
+
+static inline uint8_t* frame_put32(uint8_t *p, uint32_t value)
+{
+	p = frame_put16(p, value);
+	return frame_put16(p, value >> 16);
+}
+
+static inline uint16_t frame_get16(const uint8_t *p)
+{
+	return p[0] | ((uint16_t)p[1] << 8);
+}
+
+static inline uint32_t frame_get32(const uint8_t *p)
+{
+	return frame_get16(p) | ((uint32_t)frame_get16(p + 2) << 16);
+}
+
+#endif /* FRAME_H_ */
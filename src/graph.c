@@ -0,0 +1,177 @@
+/*
+ * graph.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include <string.h>
+#include "lcd.h"
+#include "graph.h"
+
+#define GLYPH_ROWS 8
+#define GRAPH_MAX_CELLS 20	//a row of a 20x4 display
+
+static uint8_t graph_cgram[8 * GLYPH_ROWS];	//copy of the glyphs held by the controller
+static uint8_t graph_cells[GRAPH_MAX_CELLS];	//characters of the bar on the screen, 0 when unknown
+static uint8_t graph_spark_shown;	//the sparkline cells are on the screen
+static uint16_t graph_history[GRAPH_SPARK_SAMPLES];
+static uint8_t graph_history_count;
+
+
+static void graph_glyph(uint8_t glyph, const uint8_t *rows)
+{
+	/* Sends the rows of a glyph that differ from the copy in
+	 * RAM. A run of changed rows takes a single address command
+	 * since the controller increments the address by itself.
+	 */
+	uint8_t *copy = &graph_cgram[glyph * GLYPH_ROWS];
+	uint8_t addressed = 0;
+	for(uint8_t i = 0; i < GLYPH_ROWS; ++i)
+	{
+		if(copy[i] == rows[i])
+		{
+			addressed = 0;
+			continue;
+		}
+		if(!addressed)
+		{
+			lcd_command(LCD_SETCGRAMADDR | (glyph * GLYPH_ROWS + i));
+			addressed = 1;
+		}
+		lcd_write(rows[i]);
+		copy[i] = rows[i];
+	}
+	return;
+}
+
+
+void graph_init(void)
+{
+	//uploads every glyph blank once, from then on only the changes are sent
+	memset(graph_cgram, 0, sizeof(graph_cgram));
+	for(uint8_t glyph = 0; glyph < 8; ++glyph)
+		lcd_create_char(glyph, &graph_cgram[glyph * GLYPH_ROWS]);
+	graph_invalidate();
+	lcd_set_cursor(0, 0);	//back to the display memory
+	return;
+}
+
+
+void graph_invalidate(void)
+{
+	//the screen has been cleared or written over, every cell has to be written again
+	memset(graph_cells, 0, sizeof(graph_cells));
+	graph_spark_shown = 0;
+	return;
+}
+
+
+void graph_bar(uint8_t col, uint8_t row, uint8_t cells, uint8_t percent)
+{
+	/* Draws a horizontal bar of the given number of cells with
+	 * a resolution of one pixel column, 5 per cell. Full cells
+	 * use the full block of the character ROM, the cell at the
+	 * tip of the bar uses the bar glyph.
+	 */
+	if(cells > GRAPH_MAX_CELLS)
+		cells = GRAPH_MAX_CELLS;
+	if(percent > 100)
+		percent = 100;
+	uint16_t pixels = (uint16_t)percent * cells * 5 / 100;
+	uint8_t full = pixels / 5;
+	uint8_t part = pixels % 5;
+
+	uint8_t rows[GLYPH_ROWS];
+	uint8_t mask = (0x1F << (5 - part)) & 0x1F;
+	for(uint8_t i = 0; i < GLYPH_ROWS; ++i)
+		rows[i] = (i == 0 || i == GLYPH_ROWS - 1) ? 0 : mask;	//a blank top and bottom row like the text
+	graph_glyph(GRAPH_BAR_GLYPH, rows);
+
+	uint8_t addressed = 0;
+	for(uint8_t i = 0; i < cells; ++i)
+	{
+		//codes 8 to 15 show glyphs 0 to 7 again, 8 keeps 0 free to mean unknown in the cell copy
+		uint8_t cell = (i < full) ? GRAPH_FULL_BLOCK : (i == full && part) ? GRAPH_BAR_GLYPH + 8 : ' ';
+		if(graph_cells[i] == cell)
+		{
+			addressed = 0;
+			continue;
+		}
+		if(!addressed)
+		{
+			lcd_set_cursor(col + i, row);
+			addressed = 1;
+		}
+		lcd_write(cell);
+		graph_cells[i] = cell;
+	}
+	lcd_set_cursor(col + cells, row);	//leave the address in the display memory after a glyph update
+	return;
+}
+
+
+void graph_spark_add(uint16_t value)
+{
+	//appends a sample, the oldest one is dropped once the history is full
+	if(graph_history_count == GRAPH_SPARK_SAMPLES)
+		memmove(graph_history, graph_history + 1, sizeof(graph_history) - sizeof(graph_history[0]));
+	else
+		++graph_history_count;
+	graph_history[graph_history_count - 1] = value;
+	return;
+}
+
+
+void graph_spark(uint8_t col, uint8_t row, uint16_t min_span)
+{
+	/* Draws the sample history as columns of 1 to 8 pixels, the
+	 * newest sample on the right. The scale follows the lowest
+	 * and highest sample but never spans less than min_span so
+	 * noise doesn't fill the whole height.
+	 */
+	uint16_t low = 0xFFFF, high = 0;
+	for(uint8_t i = 0; i < graph_history_count; ++i)
+	{
+		if(graph_history[i] < low)
+			low = graph_history[i];
+		if(graph_history[i] > high)
+			high = graph_history[i];
+	}
+	if(high - low < min_span)
+	{
+		uint16_t middle = low + (high - low) / 2;
+		low = (middle > min_span / 2) ? middle - min_span / 2 : 0;
+		high = low + min_span;
+	}
+	if(high == low)
+		++high;
+
+	//heights of every pixel column, 0 for the columns without a sample yet
+	uint8_t heights[GRAPH_SPARK_SAMPLES];
+	uint8_t empty = GRAPH_SPARK_SAMPLES - graph_history_count;
+	for(uint8_t i = 0; i < GRAPH_SPARK_SAMPLES; ++i)
+		heights[i] = (i < empty) ? 0 : 1 + (uint32_t)(graph_history[i - empty] - low) * (GLYPH_ROWS - 1) / (high - low);
+
+	for(uint8_t cell = 0; cell < GRAPH_SPARK_CELLS; ++cell)
+	{
+		uint8_t rows[GLYPH_ROWS];
+		for(uint8_t r = 0; r < GLYPH_ROWS; ++r)
+		{
+			rows[r] = 0;
+			for(uint8_t c = 0; c < 5; ++c)
+				if(heights[cell * 5 + c] >= GLYPH_ROWS - r)
+					rows[r] |= 0x10 >> c;
+		}
+		graph_glyph(GRAPH_SPARK_GLYPH + cell, rows);
+	}
+
+	if(!graph_spark_shown)
+	{
+		lcd_set_cursor(col, row);
+		for(uint8_t cell = 0; cell < GRAPH_SPARK_CELLS; ++cell)
+			lcd_write(GRAPH_SPARK_GLYPH + cell);
+		graph_spark_shown = 1;
+	}
+	lcd_set_cursor(col + GRAPH_SPARK_CELLS, row);
+	return;
+}
@@ -0,0 +1,32 @@
+/*
+ * graph.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef GRAPH_H_
+#define GRAPH_H_
+
+#include <stdint.h>
+
+/* Bar graph and sparkline drawn with the 8 custom glyphs of the
+ * LCD controller. A copy of the glyphs is kept in RAM so only the
+ * glyph bytes that change are sent to the controller, the cells
+ * showing a glyph follow its bytes without being written again.
+ * Glyph 0 is the partly filled cell of the bar, glyphs 1 to 7 are
+ * the sparkline.
+ */
+#define GRAPH_BAR_GLYPH 0
+#define GRAPH_SPARK_GLYPH 1
+#define GRAPH_SPARK_CELLS 7
+#define GRAPH_SPARK_SAMPLES (GRAPH_SPARK_CELLS * 5)	//one sample per pixel column
+#define GRAPH_FULL_BLOCK 0xFF	//all pixels set, from the character ROM
+
+void graph_init(void);
+void graph_invalidate(void);
+void graph_bar(uint8_t col, uint8_t row, uint8_t cells, uint8_t percent);
+void graph_spark_add(uint16_t value);
+void graph_spark(uint8_t col, uint8_t row, uint16_t min_span);
+
+#endif /* GRAPH_H_ */
@@ -1,81 +1,206 @@
 #include "lcd.h"
+#include "pgm.h"
 
 #include <stdarg.h>
-#include <stdio.h>
+#include <string.h>
 #include <util/delay.h>
 
 void lcd_send(uint8_t value, uint8_t mode);
-void lcd_write_nibble(uint8_t nibble);
 
+// The port and the pins are constants, each of these is a single
+// sbi or cbi instruction
+#define LCD_PIN_HIGH(pin) (LCD_PORT |= (1 << (pin)))
+#define LCD_PIN_LOW(pin) (LCD_PORT &= ~(1 << (pin)))
+#define LCD_PIN_WRITE(pin, high) do { if (high) LCD_PIN_HIGH(pin); else LCD_PIN_LOW(pin); } while (0)
+
+#define LCD_INIT_DONE 0xff
+
+// Controllers a transfer goes to, bit 0 the first and bit 1 the second.
+// Without a second controller it is a constant and the pulse stays a
+// single sbi/cbi. EN2 is on a port of its own and pulsed along with EN.
+#define LCD_FIRST 0x01
+#define LCD_SECOND 0x02
+#ifdef LCD_EN2
+#define LCD_BOTH (LCD_FIRST | LCD_SECOND)
+static uint8_t lcd_enable = LCD_BOTH;
+#define LCD_EN_MASK ((lcd_enable & LCD_FIRST) ? (1 << LCD_EN) : 0)
+#define LCD_EN2_HIGH() do { if (lcd_enable & LCD_SECOND) LCD_EN2_PORT |= (1 << LCD_EN2); } while (0)
+#define LCD_EN2_LOW() (LCD_EN2_PORT &= ~(1 << LCD_EN2))
+#else
+#define lcd_enable LCD_FIRST
+#define LCD_EN_MASK (1 << LCD_EN)
+#define LCD_EN2_HIGH()
+#define LCD_EN2_LOW()
+#endif
+
+static uint8_t lcd_cols = LCD_COL_COUNT;
+static uint8_t lcd_row_count = LCD_ROW_COUNT;
 static uint8_t lcd_displayparams;
-static char lcd_buffer[LCD_COL_COUNT + 1];
-
+static uint8_t lcd_init_state;
+static uint8_t lcd_init_delay;
+static uint16_t lcd_init_time;
+
+#ifdef LCD_BUS_STATS
+struct lcd_bus_stats lcd_bus_stats;
+#define LCD_BUS_COUNT(field, n) (lcd_bus_stats.field += (n))
+#else
+#define LCD_BUS_COUNT(field, n)
+#endif
+
+// Everything but a display memory address goes to every controller, so
+// does the data following a CGRAM address. Text goes to the controller
+// of the row picked by lcd_set_cursor, the first one after a clear.
 void lcd_command(uint8_t command) {
+#ifdef LCD_EN2
+  if (!(command & LCD_SETDDRAMADDR)) {
+    lcd_enable = LCD_BOTH;
+  }
+#endif
   lcd_send(command, 0);
+#ifdef LCD_EN2
+  if (command < LCD_SETCGRAMADDR) {
+    lcd_enable = LCD_FIRST;
+  }
+#endif
 }
 
 void lcd_write(uint8_t value) {
   lcd_send(value, 1);
 }
 
+// EN is low between transfers. The controller latches the data on the
+// falling edge of EN, so the data may change along with the rising edge
+static inline void lcd_write_nibble(uint8_t nibble) {
+#ifdef LCD_DATA_CONTIGUOUS
+  LCD_PORT = (LCD_PORT & ~LCD_DATA_MASK) | ((nibble & 0x0f) << LCD_D0) | LCD_EN_MASK;
+#else
+  LCD_PIN_WRITE(LCD_D0, nibble & 0x01);
+  LCD_PIN_WRITE(LCD_D1, nibble & 0x02);
+  LCD_PIN_WRITE(LCD_D2, nibble & 0x04);
+  LCD_PIN_WRITE(LCD_D3, nibble & 0x08);
+  LCD_PORT |= LCD_EN_MASK;
+#endif
+  LCD_EN2_HIGH();
+  _delay_us(0.5);  // EN high for at least 450ns
+  LCD_PORT &= ~(1 << LCD_EN);
+  LCD_EN2_LOW();
+  _delay_ms(0.04);
+  LCD_BUS_COUNT(nibbles, 1);
+  LCD_BUS_COUNT(wait_us, 40);
+}
+
 void lcd_send(uint8_t value, uint8_t mode) {
   if (mode) {
-    LCD_PORT = LCD_PORT | (1 << LCD_RS);
+    LCD_PIN_HIGH(LCD_RS);
+    LCD_BUS_COUNT(data, 1);
   } else {
-    LCD_PORT = LCD_PORT & ~(1 << LCD_RS);
+    LCD_PIN_LOW(LCD_RS);
+    LCD_BUS_COUNT(commands, 1);
   }
 
-  LCD_PORT = LCD_PORT & ~(1 << LCD_RW);
+#ifdef LCD_RW
+  LCD_PIN_LOW(LCD_RW);
+#endif
 
   lcd_write_nibble(value >> 4);
   lcd_write_nibble(value);
 }
 
-void lcd_write_nibble(uint8_t nibble) {
-  LCD_PORT = (LCD_PORT & 0xff & ~(0x0f << LCD_D0)) | ((nibble & 0x0f) << LCD_D0);
-
-  LCD_PORT = LCD_PORT & ~(1 << LCD_EN);
-  LCD_PORT = LCD_PORT | (1 << LCD_EN);
-  LCD_PORT = LCD_PORT & ~(1 << LCD_EN);
-  _delay_ms(0.04);
+void lcd_set_geometry(uint8_t cols, uint8_t rows) {
+  lcd_cols = (cols > LCD_MAX_COL_COUNT) ? LCD_MAX_COL_COUNT : cols;
+  lcd_row_count = (rows > 4) ? 4 : (rows ? rows : 1);
 }
 
-void lcd_init(void) {
-  // Configure pins as output
-  LCD_DDR = LCD_DDR
-    | (1 << LCD_RS)
-    | (1 << LCD_RW)
-    | (1 << LCD_EN)
-    | (1 << LCD_D0)
-    | (1 << LCD_D1)
-    | (1 << LCD_D2)
-    | (1 << LCD_D3);
-
-  // Wait for LCD to become ready (docs say 15ms+)
-  _delay_ms(15);
-
-  LCD_PORT = LCD_PORT
-    & ~(1 << LCD_EN)
-    & ~(1 << LCD_RS)
-    & ~(1 << LCD_RW);
-
-  _delay_ms(4.1);
+uint8_t lcd_columns(void) {
+  return lcd_cols;
+}
 
-  lcd_write_nibble(0x03); // Switch to 4 bit mode
-  _delay_ms(4.1);
+uint8_t lcd_rows(void) {
+  return lcd_row_count;
+}
 
-  lcd_write_nibble(0x03); // 2nd time
-  _delay_ms(4.1);
+void lcd_init(void) {
+  uint16_t now = 0;
 
-  lcd_write_nibble(0x03); // 3rd time
-  _delay_ms(4.1);
+  while (!lcd_init_poll(now)) {
+    _delay_ms(1);
+    now++;
+  }
+}
 
-  lcd_write_nibble(0x02); // Set 8-bit mode (?)
+// Runs the power-up sequence as a state machine so the caller can do
+// other work during the delays. Call it with a millisecond time stamp
+// until it returns 1.
+uint8_t lcd_init_poll(uint16_t now) {
+  if (lcd_init_state == LCD_INIT_DONE) {
+    return 1;
+  }
 
-  lcd_command(LCD_FUNCTIONSET | LCD_4BITMODE | LCD_2LINE | LCD_5x8DOTS);
+  // The time stamps have a 1ms resolution, the delays are rounded up
+  if (lcd_init_state && (uint16_t)(now - lcd_init_time) < lcd_init_delay) {
+    return 0;
+  }
+  lcd_init_time = now;
+
+  switch (lcd_init_state++) {
+    case 0:
+      // Configure pins as output
+      LCD_DDR = LCD_DDR
+        | (1 << LCD_RS)
+#ifdef LCD_RW
+        | (1 << LCD_RW)
+#endif
+        | (1 << LCD_EN)
+        | (1 << LCD_D0)
+        | (1 << LCD_D1)
+        | (1 << LCD_D2)
+        | (1 << LCD_D3);
+#ifdef LCD_EN2
+      LCD_EN2_DDR |= (1 << LCD_EN2);
+#endif
+
+      // Wait for LCD to become ready (docs say 15ms+)
+      lcd_init_delay = 16;
+      break;
+
+    case 1:
+      LCD_PORT = LCD_PORT
+        & ~(1 << LCD_EN)
+        & ~(1 << LCD_RS);
+      LCD_EN2_LOW();
+#ifdef LCD_EN2
+      lcd_enable = LCD_BOTH;
+#endif
+
+#ifdef LCD_RW
+      LCD_PORT = LCD_PORT & ~(1 << LCD_RW);
+#endif
+
+      lcd_init_delay = 6; // 4.1ms
+      break;
+
+    case 2: // Switch to 4 bit mode
+    case 3: // 2nd time
+    case 4: // 3rd time
+      lcd_write_nibble(0x03);
+      break;
+
+    default:
+      lcd_write_nibble(0x02); // Set 8-bit mode (?)
+
+      lcd_command(LCD_FUNCTIONSET | LCD_4BITMODE | LCD_2LINE | LCD_5x8DOTS);
+
+      lcd_displayparams = LCD_CURSOROFF | LCD_BLINKOFF;
+      lcd_command(LCD_DISPLAYCONTROL | lcd_displayparams);
+
+      lcd_init_state = LCD_INIT_DONE;
+      return 1;
+  }
+  return 0;
+}
 
-  lcd_displayparams = LCD_CURSOROFF | LCD_BLINKOFF;
-  lcd_command(LCD_DISPLAYCONTROL | lcd_displayparams);
+uint8_t lcd_ready(void) {
+  return lcd_init_state == LCD_INIT_DONE;
 }
 
 void lcd_on(void) {
@@ -91,11 +216,13 @@ void lcd_off(void) {
 void lcd_clear(void) {
   lcd_command(LCD_CLEARDISPLAY);
   _delay_ms(2);
+  LCD_BUS_COUNT(wait_us, 2000);
 }
 
 void lcd_return_home(void) {
   lcd_command(LCD_RETURNHOME);
   _delay_ms(2);
+  LCD_BUS_COUNT(wait_us, 2000);
 }
 
 void lcd_enable_blinking(void) {
@@ -153,14 +280,21 @@ void lcd_create_char(uint8_t location, uint8_t *charmap) {
   }
 }
 
+// A controller has two lines at 0x00 and 0x40. A 4 row display on a
+// single controller continues each of them a row further down, rows 2
+// and 3 start a row width after rows 0 and 1 (0x14 and 0x54 on 20x4).
 void lcd_set_cursor(uint8_t col, uint8_t row) {
-  static uint8_t offsets[] = { 0x00, 0x40, 0x14, 0x54 };
-
-  if (row > 1) {
-    row = 1;
+  if (row >= lcd_row_count) {
+    row = lcd_row_count - 1;
   }
 
-  lcd_command(LCD_SETDDRAMADDR | (col + offsets[row]));
+#ifdef LCD_EN2
+  lcd_enable = (row < 2) ? LCD_FIRST : LCD_SECOND;
+  uint8_t offset = (row & 1) ? 0x40 : 0x00;
+#else
+  uint8_t offset = ((row & 1) ? 0x40 : 0x00) + ((row & 2) ? lcd_cols : 0);
+#endif
+  lcd_command(LCD_SETDDRAMADDR | (col + offset));
 }
 
 void lcd_puts(char *string) {
@@ -169,12 +303,167 @@ void lcd_puts(char *string) {
   }
 }
 
+// lcd_puts for a string kept in flash, e.g. lcd_puts_P(PSTR("TEXT"))
+void lcd_puts_P(const char *string) {
+  for (char c; (c = pgm_read_byte(string)); string++) {
+    lcd_write(c);
+  }
+}
+
+// Writes up to n copies of c, stops at the end of a row
+static uint8_t lcd_pad(char c, int8_t n, uint8_t count) {
+  for (; n > 0 && count < lcd_cols; n--, count++) {
+    lcd_write(c);
+  }
+  return count;
+}
+
+// Reads a character of a string kept in SRAM or in flash
+#define LCD_FETCH(p, flash) ((flash) ? (char)pgm_read_byte(p) : *(p))
+
+// A minimal printf that writes straight to the LCD, at most one row
+// like the buffer it replaces. Only %[-][0][width][.decimals][l]u|d
+// plus %s, %S (a string in flash), %c and %% are supported. The
+// decimals of %u and %d are fixed point: lcd_printf("%4.1u", 115)
+// writes "11.5". The format is read from flash when flash is set.
+static void lcd_vprintf(const char *format, uint8_t flash, va_list args) {
+  uint8_t count = 0;
+  char c;
+
+  for (const char *f = format; (c = LCD_FETCH(f, flash)) && count < lcd_cols; f++) {
+    if (c != '%') {
+      lcd_write(c);
+      count++;
+      continue;
+    }
+    if (!(c = LCD_FETCH(++f, flash))) {
+      break;  // a lone % at the end of the format
+    }
+
+    uint8_t left = 0, zero = 0, width = 0, decimals = 0, is_long = 0;
+    if (c == '-') {
+      left = 1;
+      c = LCD_FETCH(++f, flash);
+    }
+    if (c == '0') {
+      zero = 1;
+      c = LCD_FETCH(++f, flash);
+    }
+    for (; c >= '0' && c <= '9'; c = LCD_FETCH(++f, flash)) {
+      width = width * 10 + c - '0';
+    }
+    if (c == '.') {
+      for (c = LCD_FETCH(++f, flash); c >= '0' && c <= '9'; c = LCD_FETCH(++f, flash)) {
+        decimals = decimals * 10 + c - '0';
+      }
+    }
+    if (c == 'l') {
+      is_long = 1;
+      c = LCD_FETCH(++f, flash);
+    }
+
+    char digits[16];
+    const char *s = digits + sizeof(digits);
+    char *d = digits + sizeof(digits);
+    char sign = 0;
+    uint8_t length, in_flash = 0;
+    if (c == 'u' || c == 'd') {
+      uint32_t value;
+      if (c == 'u') {
+        value = is_long ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+      } else {
+        int32_t number = is_long ? va_arg(args, long) : va_arg(args, int);
+        value = (number < 0) ? -(uint32_t)number : (uint32_t)number;
+        sign = (number < 0) ? '-' : 0;
+      }
+      // Digits from the right, the point goes after the decimals with
+      // at least one digit in front of it
+      uint8_t n = 0;
+      do {
+        *--d = '0' + value % 10;
+        value /= 10;
+        if (++n == decimals && d > digits + 1) {
+          *--d = '.';
+        }
+      } while ((value || n <= decimals) && d > digits);
+      s = d;
+      length = digits + sizeof(digits) - d;
+    } else if (c == 's') {
+      s = va_arg(args, char *);
+      length = strlen(s);
+    } else if (c == 'S') {
+      s = va_arg(args, const char *);
+      length = strlen_P(s);
+      in_flash = 1;
+    } else {
+      *--d = (c == 'c') ? (char)va_arg(args, int) : c;  // %c, %% and anything unsupported
+      s = d;
+      length = 1;
+    }
+
+    int8_t padding = width - length - (sign ? 1 : 0);
+    if (!left && !zero) {
+      count = lcd_pad(' ', padding, count);
+    }
+    if (sign) {
+      count = lcd_pad(sign, 1, count);
+    }
+    if (!left && zero) {
+      count = lcd_pad('0', padding, count);
+    }
+    for (; length && count < lcd_cols; length--, count++) {
+      lcd_write(LCD_FETCH(s++, in_flash));
+    }
+    if (left) {
+      count = lcd_pad(' ', padding, count);
+    }
+  }
+}
+
 void lcd_printf(char *format, ...) {
   va_list args;
+  va_start(args, format);
+  lcd_vprintf(format, 0, args);
+  va_end(args);
+}
 
+// lcd_printf with the format kept in flash, e.g. lcd_printf_P(PSTR("%4u%%"), soc)
+void lcd_printf_P(const char *format, ...) {
+  va_list args;
   va_start(args, format);
-  vsnprintf(lcd_buffer, LCD_COL_COUNT + 1, format, args);
+  lcd_vprintf(format, 1, args);
   va_end(args);
+}
 
-  lcd_puts(lcd_buffer);
+void LCDWriteInt(int val,unsigned int field_length)
+{
+	/***************************************************************
+	This function writes a integer type value to LCD module
+
+	Arguments:
+	1)int val	: Value to print
+
+	2)unsigned int field_length :total length of field in which the value is printed
+	must be between 1-5 if it is -1 the field length is no of digits in the val
+
+	****************************************************************/
+
+	char str[5] = {0, 0, 0, 0, 0};
+	int i = 4, j = 0;
+	while(val)
+	{
+		str[i] = val % 10;
+		val = val / 10;
+		i--;
+	}
+	if(field_length == -1)
+		while(str[j] == 0) j++;
+	else
+		j = 5 - field_length;
+
+	if(val < 0) LCDData('-');
+	for(i = j; i < 5; i++)
+	{
+		LCDData(48 + str[i]);
+	}
 }
@@ -6,16 +6,38 @@
 #define LCD_DDR  DDRD
 #define LCD_PORT PORTD
 
-#define LCD_RS 0
-#define LCD_RW 1
-#define LCD_EN 2
-#define LCD_D0 3
-#define LCD_D1 4
-#define LCD_D2 5
-#define LCD_D3 6
-
+// PD0/PD1 are taken by the USART, RW is tied to ground since the
+// display is never read. Define LCD_RW if the pin is wired up.
+#define LCD_RS 2
+#define LCD_EN 3
+#define LCD_D0 4
+#define LCD_D1 5
+#define LCD_D2 6
+#define LCD_D3 7
+
+// A second controller, either the lower half of a 40x4 module or a
+// second display, has its own enable line and shows rows 2 and 3.
+// Everything else is shared with the first. LCD_PORT has no pin left,
+// the only free one on the board is PB7, the RS-485 driver enable, so
+// this can't be combined with MODBUS_SLAVE.
+//#define LCD_EN2 7
+#define LCD_EN2_DDR  DDRB
+#define LCD_EN2_PORT PORTB
+
+// The pins are resolved at compile time. With D0-D3 on consecutive
+// pins of the port a nibble goes out in a single store, otherwise
+// each data pin is set on its own
+#if LCD_D1 == LCD_D0 + 1 && LCD_D2 == LCD_D0 + 2 && LCD_D3 == LCD_D0 + 3
+#define LCD_DATA_CONTIGUOUS
+#endif
+#define LCD_DATA_MASK ((1 << LCD_D0) | (1 << LCD_D1) | (1 << LCD_D2) | (1 << LCD_D3))
+
+// Geometry the driver starts with, lcd_set_geometry changes it at run
+// time: 16x2, 16x4, 20x4 and 40x2 on a single controller, 40x4 (or two
+// displays) with LCD_EN2
 #define LCD_COL_COUNT 16
 #define LCD_ROW_COUNT 2
+#define LCD_MAX_COL_COUNT 40
 
 // The rest should be left alone
 #define LCD_CLEARDISPLAY   0x01
@@ -51,7 +73,13 @@
 #define LCD_5x10DOTS 0x04
 #define LCD_5x8DOTS  0x00
 
+void lcd_set_geometry(uint8_t cols, uint8_t rows);
+uint8_t lcd_columns(void);
+uint8_t lcd_rows(void);
+
 void lcd_init(void);
+uint8_t lcd_init_poll(uint16_t now);
+uint8_t lcd_ready(void);
 
 void lcd_command(uint8_t command);
 void lcd_write(uint8_t value);
@@ -84,8 +112,16 @@ void lcd_set_cursor(uint8_t col, uint8_t row);
 void lcd_puts(char *string);
 void lcd_printf(char *format, ...);
 
+// Variants for strings kept in flash (PROGMEM or PSTR, see pgm.h)
+void lcd_puts_P(const char *string);
+void lcd_printf_P(const char *format, ...);
+
 #define LCDInit() {\
 	lcd_init();\
+	LCDConfigure();\
+}
+
+#define LCDConfigure() {\
 	lcd_on();\
 	lcd_disable_blinking();\
 	lcd_disable_cursor();\
@@ -101,41 +137,26 @@ void lcd_printf(char *format, ...);
  lcd_puts(msg);\
 }
 
-#define LCDWriteIntXY(x, y, val, fl) {\
+#define LCDWriteStringXY_P(x, y, msg) {\
  lcd_set_cursor(x, y);\
- LCDWriteInt(val,fl);\
+ lcd_puts_P(msg);\
 }
 
-void LCDWriteInt(int val,unsigned int field_length)
-{
-	/***************************************************************
-	This function writes a integer type value to LCD module
-
-	Arguments:
-	1)int val	: Value to print
-
-	2)unsigned int field_length :total length of field in which the value is printed
-	must be between 1-5 if it is -1 the field length is no of digits in the val
-
-	****************************************************************/
-
-	char str[5] = {0, 0, 0, 0, 0};
-	int i = 4, j = 0;
-	while(val)
-	{
-		str[i] = val % 10;
-		val = val / 10;
-		i--;
-	}
-	if(field_length == -1)
-		while(str[j] == 0) j++;
-	else
-		j = 5 - field_length;
-
-	if(val < 0) LCDData('-');
-	for(i = j; i < 5; i++)
-	{
-		LCDData(48 + str[i]);
-	}
+#define LCDWriteIntXY(x, y, val, fl) {\
+ lcd_set_cursor(x, y);\
+ LCDWriteInt(val,fl);\
 }
 
+void LCDWriteInt(int val, unsigned int field_length);
+
+// Define LCD_BUS_STATS to count the traffic on the LCD bus, used by
+// the benchmarks to compare the cost of screen updates
+#ifdef LCD_BUS_STATS
+struct lcd_bus_stats {
+  uint32_t commands;
+  uint32_t data;      // characters and CGRAM bytes
+  uint32_t nibbles;   // enable pulses
+  uint32_t wait_us;   // time spent in the busy waits after a transfer
+};
+extern struct lcd_bus_stats lcd_bus_stats;
+#endif
@@ -7,7 +7,28 @@
 #include <avr/io.h>
 #include <util/delay.h>
 #include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <avr/wdt.h>
+#include <avr/sleep.h>
 #include "defs.h"
+#include "stats.h"
+#include "uart.h"
+#include "telemetry.h"
+#include "events.h"
+#include "modbus.h"
+#include "evlog.h"
+#include "config.h"
+#include "crc.h"
+#include "prof.h"
+#include "memwatch.h"
+#include "control.h"
+#include "convert.h"
+#include "graph.h"
+#include "snapshot.h"
+#include "spsc.h"
+#include "datalog.h"
+#include "messages.h"
+#include "screens.h"
 
 //NOTE: SOC stands for STATE OF CHARGE and is represented in % ranging from 0% - 100%
 
@@ -15,11 +36,42 @@ uint8_t gBuzzer_On = FALSE;
 uint8_t gLoad_Supply_On = FALSE;	//indicates when power to the connected load is enabled
 uint8_t gBattery_Charging = FALSE;	//indicates when the battery is being charged
 uint8_t gCountdown_In_Progress = FALSE;	//indicates when count down has been started and is in progress
-
-//global variables that will be modified by the ISR for TIMER1 OVERFLOW
-volatile uint16_t gCountdown_Time = 0;	//used to hold the value for count down timing in minutes
-volatile uint8_t gSeconds_Count = 59;	//used to hold the seconds count down
-volatile uint16_t gMilli_Seconds = 0;	//used to hold the milliseconds count
+uint8_t gBattery_SOC = 0;	//SOC value of the latest battery sample taken by battery_manager
+uint16_t gBattery_Millivolts = 0;	//battery voltage of the latest battery sample taken by battery_manager
+uint8_t gBattery_Low = FALSE;	//set by battery_manager while the SOC is below the SOC limit
+uint16_t gBoot_Protect_Time = 0;	//time from TIMER1 start-up to the first protection decision (unit = us)
+uint32_t gBoot_Millis = 0;	//system tick when TIMER1 was started, moved on along with it by a warm restart
+
+//pages battery_display goes through on a 16x2 display, in this order
+#define PAGE_BATTERY_LOW 0
+#define PAGE_CHARGING 1
+#define PAGE_STATS 2
+#define PAGE_PROFILE 3
+#define PAGE_DASHBOARD 4
+
+/* global variables that are shared with the ISR for TIMER1 COMPARE MATCH. They are
+ * only accessed through snapshot.h, the count down values are written by the main
+ * loop before it sets gCountdown_Running and by the ISR while it is set
+ */
+struct snapshot32 gMillis = SNAPSHOT_INIT(0);	//milliseconds elapsed since the module was powered up
+uint8_t gCountdown_Running = FALSE;	//indicates when the TIMER1 ISR should decrement the count down
+uint8_t gCountdown_Expired = FALSE;	//set by the TIMER1 ISR when the count down reaches 0
+struct snapshot16 gCountdown_Time = SNAPSHOT_INIT(0);	//used to hold the value for count down timing in minutes
+uint8_t gSeconds_Count = 59;	//used to hold the seconds count down
+uint16_t gMilli_Seconds = 0;	//used to hold the milliseconds count, only used by the ISR while the count down runs
+
+/* The count down is shown by the main loop, the TIMER1 ISR only
+ * queues the time left every second. Writing to the LCD from the
+ * ISR would busy wait on the LCD with interrupts disabled and mix
+ * up the pages drawn by the main loop.
+ */
+struct countdown_tick
+{
+	uint16_t minutes;
+	uint8_t seconds;
+};
+SPSC_QUEUE(countdown_queue, struct countdown_tick, 4)
+struct countdown_queue gCountdown_Ticks;
 
 /* used to hold the minimum battery voltage level that is set by the user to indicate when
  * supply to the connected load should be disconnected if the battery voltage level
@@ -27,74 +79,176 @@ volatile uint16_t gMilli_Seconds = 0;	//used to hold the milliseconds count
  */
 uint16_t gSOC_Limit = DEFAULT_SOC_VALUE;
 
-/* this pointer is to be used by float_to_string
- * routine to return values from memory when
- * called. This is as to solve the problem of
- * not being able to return an array by copying
- * but rather the pointer to the array can be
- * returned by copying. Returning pointer to
- * local variables isn't viable since the variable's
- * location in stack memory is cleaned after the
- * routine is through with its execution
+uint8_t gLoad_Outputs = 0;	//outputs of the load channels, bits of LOAD_PORT
+struct control_calibration gCalibration;	//correction of the battery voltage reading of this unit
+
+/* Control state kept across a watchdog, brown-out or external
+ * reset. It lives in .noinit so the C start-up code leaves it
+ * alone, the CRC tells whether it survived the reset. It is
+ * refreshed with every battery sample and every control event,
+ * so a count down resumes at most CONTROL_SLOW_PERIOD behind.
  */
-char* gString = NULL;
+#define WARM_STATE_MAGIC 0xB7
+struct warm_state
+{
+	uint8_t magic;
+	uint8_t load_on;
+	uint8_t charging;
+	uint8_t buzzer_on;
+	uint8_t countdown_in_progress;
+	uint8_t countdown_running;
+	uint8_t countdown_expired;
+	uint8_t load_outputs;
+	uint8_t seconds_count;
+	uint16_t milli_seconds;
+	uint16_t countdown_time;
+	uint16_t soc_limit;
+	uint16_t millivolts;	//latest battery sample, used instead of waiting for a new conversion
+	uint8_t soc;
+	uint8_t modbus_address;
+	uint32_t millis;
+	uint16_t crc;
+};
+struct warm_state gWarm_State __attribute__((section(".noinit")));
 
 //ADC operations
 static void ADC_init();
 static uint16_t ADC_read(uint8_t);
 
-//string operations
-static uint16_t string_to_integer(char*);
-static char* float_to_string(float, char);
-
 //battery management operations
-static void battery_manager();
-static inline float battery_voltage_level();
-static inline float soc_calculator();
+static uint16_t battery_manager();
+static void battery_display();
+static uint8_t battery_protect(uint8_t);
+static void load_outputs(uint8_t);
+static inline uint16_t battery_millivolts();
 static void led_display(float);
+static void dashboard_display();
+#ifdef PROFILING
+static void profile_display();
+#endif
+static void log_event(uint8_t);
 
 //settings operations
 static void settings();
 static void set_soc_limit();
 static void set_countdown_time();
+static void set_calibration();
 
 //time count down operations
-static void setup_timer1();
+void setup_timer1();
+static uint32_t millis();
+static uint16_t boot_micros();
 static void init_countdown();
 static void terminate_countdown();
+static void countdown_poll();
 
 //matrix keypad operations
 static char scan_keypad_input(int16_t);
 
 //main control
 static void central_hub();
+static void background_tasks();
+static void wait_ms(uint16_t);
+static void idle();
+static uint8_t status_flags();
+static void restore_settings();
+static void save_settings();
+static uint8_t warm_restore(uint8_t);
+static void warm_save();
+static void countdown_expired();
 
 
 #ifndef TEST
 
 int main()
 {
+	//keep the reset flags, they are cleared by the writes below
+	uint8_t reset_cause = MCUCSR & ((1 << JTRF) | (1 << WDRF) | (1 << BORF) | (1 << EXTRF) | (1 << PORF));
+
 	// Disable JTAG port
 	MCUCSR = (1<<JTD);
 	MCUCSR = (1<<JTD);
 
-	//initialize ADC and LCD
-	ADC_init();
-	LCDInit();
+	/* The boot is staged so that the battery is protected as
+	 * early as possible:
+	 * 1. drive every actuator to a safe state
+	 * 2. take the first battery sample and apply protection
+	 * 3. bring up the LCD in the background while the rest
+	 *    of the module is initialized
+	 * After a watchdog, brown-out or external reset stage 2 is
+	 * replaced by restoring the control state kept in RAM.
+	 */
+
+	//stage 1: load, charger and buzzer OFF before the pins become outputs
+	LOAD_SUPPLY_OFF;
+	LOAD_PORT &= ~LOAD_CHANNEL_MASK;
+	BATTERY_CHARGE_OFF;
+	BUZZER_OFF;
+	FLASH_DESELECT;	//keeps the data logger's flash off the software SPI pins
 
 	//initialize all required port pins to either input or output pin
 	DDRA = 0b11111011;	//all pins except pin PA2 are output pins
 	DDRB = 0b10001111;	//all pins except pins PB4, PB5, PB6 are output pins
-	DDRC = 0b11101111;	//all pins except pin PC4 are output pins
-	
+	DDRC = 0b01101111;	//all pins except pins PC4, PC7 are output pins
+
 	//disable all LED bulbs during initialization of the module
 	DISABLE_LED(PC0);
 	DISABLE_LED(PC1);
 	DISABLE_LED(PC2);
 	DISABLE_LED(PC3);
 
-	//setup the TIMER1 counter which is to be used during count downs in the program
+	//setup the TIMER1 counter which is to be used as the system tick and during count downs in the program
 	setup_timer1();
+	set_sleep_mode(SLEEP_MODE_IDLE);	//the timers, the ADC and the USART keep running while the CPU sleeps
+#ifdef PROFILING
+	prof_init();
+#endif
+
+	//stage 2: restore the settings (a single pass over the EEPROM) and take the first protection decision
+	ADC_init();
+	modbus_init(MODBUS_ADDRESS);
+	if(!config_load_calibration(&gCalibration))
+		control_calibration_init(&gCalibration);
+	uint8_t warm = warm_restore(reset_cause);
+	//after the restore has moved the system tick on, before a cutoff or a charge start at power up is counted
+	stats_init(millis());
+	if(!warm)
+	{
+		restore_settings();
+		uint16_t millivolts = battery_millivolts();
+		gBattery_Millivolts = millivolts;
+		gBattery_SOC = control_soc(millivolts);
+		battery_protect(gBattery_SOC);
+	}
+	gBoot_Protect_Time = boot_micros();
+
+	//from now on every wait loop runs the background tasks, which feed the watchdog
+	wdt_enable(WDTO_500MS);
+
+	//stage 3: initialize the rest while the LCD runs through its power-up delays
+#ifdef MODBUS_SLAVE
+	//serve Modbus RTU requests over the USART
+	uart_init(MODBUS_BAUD_RATE);
+	modbus_rtu_init();
+#else
+	//start streaming telemetry frames over the USART
+	uart_init(TELEMETRY_BAUD_RATE);
+	telemetry_init(TELEMETRY_PERIOD);
+#endif
+	evlog_init();
+	datalog_init(DATALOG_PERIOD);
+	log_event(warm ? EVENT_WARM_RESTART : EVENT_BOOT);
+	telemetry_send_boot(gBoot_Protect_Time, reset_cause | (warm ? FRAME_BOOT_WARM : 0));
+
+	lcd_set_geometry(DISPLAY_COLUMNS, DISPLAY_ROWS);
+	while(!lcd_init_poll(millis()))
+		background_tasks();
+	LCDConfigure();
+	graph_init();
+
+	//a restored count down can only be shown now that the LCD is ready
+	if(gCountdown_In_Progress && !shared_load8(&gCountdown_Expired))
+		screen_countdown(snapshot16_read(&gCountdown_Time), shared_load8(&gSeconds_Count));
 
 	while(1)
 		central_hub();
@@ -106,8 +260,13 @@ int main()
 
 void ADC_init()
 {
+#ifdef ADC_INTERNAL_REFERENCE
+    // internal 2.56V reference, AREF is decoupled with a capacitor
+    ADMUX = (1<<REFS1) | (1<<REFS0);
+#else
     // AREF = AVcc
     ADMUX = (1<<REFS0);
+#endif
 
     // ADC Enable and prescaler of 128
     // 12000000/128 = 93750Hz
@@ -141,200 +300,222 @@ uint16_t ADC_read(uint8_t ch)
 }
 
 
-uint16_t string_to_integer(char* string)
+uint16_t battery_manager()
 {
-	/* This routine converts a NULL
-	 * terminated string to a 16 bit
-	 * unsigned integer
+	/* This routine manages every aspect of the battery
+	 * component. It is able to determine when the battery
+	 * is low thereby disconnecting the battery from the
+	 * load. It is able to detect when the battery needs
+	 * charging if there is an available external power
+	 * supply. It is able to display the battery level status
+	 * via LED bulbs. It is run by the background tasks and
+	 * returns the time to its next run (unit = ms): short
+	 * next to a threshold or while the SOC is moving, long
+	 * while the battery is far from every threshold.
 	 */
-	uint16_t integer = 0;
-	int string_length = strlen(string);
-	for(int i = 0; i < string_length; ++i)
-	{
-		integer *= 10;
-		integer += string[i] - '0';
-	}
-	return integer;
-}
+	PROF_ENTER(PROF_BATTERY_MANAGER);
+	static uint16_t period = CONTROL_SLOW_PERIOD;
 
-
-char* float_to_string(float value, char unit)
-{
-	/* This routine converts a float variable
-	 * to a NULL terminated string. It also
-	 * appends the unit character to the end
-	 * of the string.
+	/* take a single sample for both the LED display and the running
+	 * statistics so that the statistics don't add any sampling cost
 	 */
-	int real_part = (int)value;
-	uint8_t imag_part = (value - real_part) * 10;
-
-	gString = calloc(7, 1);	//allocate a 7 byte memory location to gString
-	strcpy(gString, "\0\0\0\0\0\0\0");
-
-	uint8_t count = 0;
-
-	int dummy = real_part;
-	do
-	{
-		++count;
-		dummy /= 10;
-	}
-	while(dummy);
-	//reserve space for the . character as well as a single decimal character
-	count += 2;
-
-	if(unit != ' ')
-		gString[count] = unit;
-	gString[count + 1] = '\0';
-	gString[--count] = (imag_part % 10) + '0';
-	gString[--count] = '.';
-
-	do
-	{
-		gString[--count] = (real_part % 10) + '0';
-		real_part /= 10;
-	}
-	while(real_part);
-
+	uint16_t millivolts = battery_millivolts();
+	uint8_t soc = control_soc(millivolts);
+	uint8_t change = (soc > gBattery_SOC) ? soc - gBattery_SOC : gBattery_SOC - soc;
+	gBattery_SOC = soc;
+	gBattery_Millivolts = millivolts;
+	led_display(soc);
+	stats_sample(millivolts, gLoad_Supply_On ? LOAD_NOMINAL_CURRENT : 0, soc < gSOC_Limit, millis());
+	gBattery_Low = battery_protect(soc);
+
+	struct control_policy policy;
+	control_policy_init(&policy, gSOC_Limit);
+	period = control_sample_period(&policy, gLoad_Channels, LOAD_CHANNEL_COUNT, soc, change, period);
+
+	/* keep the warm restart state current at the sampling rate,
+	 * the control events save it as soon as they happen
+	 */
+	warm_save();
 
-	return gString;
+	PROF_EXIT(PROF_BATTERY_MANAGER);
+	return period;
 }
 
 
-void battery_manager()
+void battery_display()
 {
-	/* This routine manages every aspect of the battery
-	 * component. It is able to determine when the battery
-	 * is low thereby disconnecting the battery from the
-	 * load. It is able to detect when the battery needs
-	 * charging if there is an available external power
-	 * supply. It is able to display the battery level status
-	 * via LED bulbs and the LCD.
+	/* Shows the latest battery sample once every DISPLAY_PERIOD.
+	 * A 16x2 display first goes through the pages that apply,
+	 * each one left up for its own time, and then shows the
+	 * dashboard until the next period. Nothing here waits, the
+	 * battery keeps being sampled while a page is up.
 	 */
+	static uint8_t page = PAGE_DASHBOARD;
+	static uint8_t stats_countdown = STATS_PAGE_PERIOD;
+	static uint8_t stats_due = FALSE;
+	static uint32_t page_end, period_end;
+	uint32_t now = millis();
+	if((int32_t)(now - page_end) < 0)
+		return;	//a page is still up
+	if(page == PAGE_DASHBOARD)
+	{
+		if((int32_t)(now - period_end) < 0)
+		{
+			//the last page is over or another screen has been left, the dashboard is back right away
+			if(!gDashboard_Shown)
+				dashboard_display();
+			return;
+		}
+		period_end = now + DISPLAY_PERIOD;
+		graph_spark_add(gBattery_Millivolts);
 
-	led_display(soc_calculator());
+		/* SOC, voltage and SOC limit are on the dashboard, the
+		 * statistics only get a page of their own every few
+		 * periods when they don't fit on it
+		 */
+		stats_due = (--stats_countdown == 0);
+		if(stats_due)
+			stats_countdown = STATS_PAGE_PERIOD;
+		page = PAGE_BATTERY_LOW;
+	}
 
-	if((uint16_t)soc_calculator() < gSOC_Limit && !gBattery_Charging)
+	//a full dashboard shows the battery state and the statistics in place
+	uint16_t hold = 0;
+	for(; !hold && page < PAGE_DASHBOARD; ++page)
 	{
-		/* This block handles low battery
-		 * situations by disconnecting the load
-		 * from the battery. It displays the
-		 * battery's SOC value to LCD. It handles
-		 * special cases where the count down
-		 * sequence is still running. It also handles
-		 * triggering of the buzzer to indicate a
-		 * low battery to the user
-		 */
-		if(!gBattery_Charging && !gBuzzer_On && (uint16_t)soc_calculator() < 45)
+		if(page == PAGE_BATTERY_LOW && gBattery_Low && !screen_full_dashboard())
 		{
-			BUZZER_ON;
-			gBuzzer_On = TRUE;
+			screen_low_page(gBattery_SOC);
+			hold = LOW_PAGE_TIME;
 		}
-
-		if(gLoad_Supply_On)
+		else if(page == PAGE_CHARGING && EXTERNAL_POWER_AVAILABLE && !screen_full_dashboard())
 		{
-			if(gCountdown_In_Progress)
-				terminate_countdown();
-			else
-			{
-				LOAD_SUPPLY_OFF;
-				gLoad_Supply_On = FALSE;
-			}
+			screen_charging_page(gBattery_SOC);
+			hold = CHARGING_PAGE_TIME;
 		}
-
-		LCDClear();
-		LCDWriteStringXY(2, 0, "BATTERY LOW");
-		LCDWriteStringXY(4, 1, float_to_string(soc_calculator(), '%'));
-		_delay_ms(300);
-		//we need to free the memory used in holding the gString to avoid heavy memory leaks
-		free(gString);
-	}
-	else if(!gCountdown_In_Progress && (uint16_t)soc_calculator() > gSOC_Limit && !gLoad_Supply_On)
-	{
-		/* This block handles situations where
-		 * there is enough battery power. It
-		 * connects the load to the battery and
-		 * it also handles special cases where
-		 * the count down sequence is still in
-		 * phase
-		 */
-		if(gBuzzer_On)
+		else if(page == PAGE_STATS && stats_due && !screen_full_dashboard())
 		{
-			BUZZER_OFF;
-			gBuzzer_On = FALSE;
+			screen_stats_page();
+			hold = STATS_PAGE_TIME;
 		}
-		LOAD_SUPPLY_ON;
-		gLoad_Supply_On = TRUE;
+#ifdef PROFILING
+		else if(page == PAGE_PROFILE && stats_due)
+		{
+			profile_display();
+			hold = STATS_PAGE_TIME;
+		}
+#endif
 	}
 
-	if(EXTERNAL_POWER_AVAILABLE)
+	if(hold)
 	{
-		/* This block handles battery charging
-		 * when there is an external power supply.
-		 */
-		if(soc_calculator() >= 95.0 && gBattery_Charging)
-		{
-			BATTERY_CHARGE_OFF;
-			gBattery_Charging = FALSE;
-		}
-		else if(soc_calculator() < 90.0 && !gBattery_Charging)
+		page_end = now + hold;
+		gDashboard_Shown = FALSE;
+	}
+	else
+		dashboard_display();
+	return;
+}
+
+
+uint8_t battery_protect(uint8_t soc)
+{
+	/* This routine takes the control decisions for a battery
+	 * sample: load, buzzer and charger. The decisions are
+	 * made by control_step, which is shared with the host
+	 * tools, this routine applies them. It doesn't touch the
+	 * LCD so it can run before the LCD has been initialized.
+	 * TRUE is returned when the battery is low.
+	 */
+	struct control_policy policy;
+	control_policy_init(&policy, gSOC_Limit);
+	//the TIMER1 ISR disconnects the load when a count down expires
+	struct control_state state = { shared_load8(&gLoad_Supply_On), gBattery_Charging, gBuzzer_On, gCountdown_In_Progress,
+			FALSE };
+	uint8_t events[CONTROL_MAX_EVENTS];
+	uint8_t count = control_step(&policy, &state, soc, EXTERNAL_POWER_AVAILABLE, events);
+
+	for(uint8_t i = 0; i < count; ++i)
+	{
+		switch(events[i])
 		{
-			BATTERY_CHARGE_ON;
-			gBattery_Charging = TRUE;
-			if(gBuzzer_On)
-			{
+			case EVENT_BUZZER_ON: {
+				BUZZER_ON;
+				gBuzzer_On = TRUE;
+				break;
+			}
+			case EVENT_BUZZER_OFF: {
 				BUZZER_OFF;
 				gBuzzer_On = FALSE;
+				break;
+			}
+			case EVENT_LOAD_OFF: {
+				//a count down in progress is terminated along with the load
+				if(gCountdown_In_Progress)
+					terminate_countdown();
+				else
+				{
+					LOAD_SUPPLY_OFF;
+					gLoad_Supply_On = FALSE;
+				}
+				stats_cutoff();
+				break;
+			}
+			case EVENT_LOAD_ON: {
+				LOAD_SUPPLY_ON;
+				gLoad_Supply_On = TRUE;
+				break;
+			}
+			case EVENT_CHARGE_ON: {
+				BATTERY_CHARGE_ON;
+				gBattery_Charging = TRUE;
+				stats_charge_start();
+				break;
+			}
+			case EVENT_CHARGE_OFF: {
+				BATTERY_CHARGE_OFF;
+				gBattery_Charging = FALSE;
+				break;
 			}
 		}
-
-		LCDClear();
-		LCDWriteStringXY(0, 0, "BATT CHARGING");
-		LCDWriteStringXY(2, 1, "SOC = ");
-		LCDWriteStringXY(8, 1, float_to_string(soc_calculator(), '%'));
-		//we need to free the memory used in holding the gString to avoid heavy memory leaks
-		free(gString);
-		_delay_ms(200);
+		log_event(events[i]);
 	}
 
-	if(!gCountdown_In_Progress)
+	//the load channels only depend on the SOC, at most one of them is connected again per sample
+	uint8_t outputs = control_shed(&policy, gLoad_Channels, LOAD_CHANNEL_COUNT, gLoad_Outputs, soc);
+	if(outputs != gLoad_Outputs)
 	{
-		LCDClear();
-		LCDWriteStringXY(0, 0, "SOC = ");
-		LCDWriteStringXY(6, 0, float_to_string(soc_calculator(), '%'));
-		//we need to free the memory used in holding the gString to avoid heavy memory leaks
-		free(gString);
-		LCDWriteStringXY(0, 1, "BATT = ");
-		LCDWriteStringXY(7, 1, float_to_string(battery_voltage_level(), 'V'));
-		_delay_ms(300);
-		//we need to free the memory used in holding the gString to avoid heavy memory leaks
-		free(gString);
-
-		LCDClear();
-		LCDWriteStringXY(0, 0, "SOC LIMIT = ");
-		LCDWriteIntXY(12, 0, gSOC_Limit, 2);
-		LCDWriteStringXY(14, 0, "%");
-		_delay_ms(300);
+		for(uint8_t i = 0; i < LOAD_CHANNEL_COUNT; ++i)
+			if((outputs ^ gLoad_Outputs) & gLoad_Channels[i].mask)
+				log_event((outputs & gLoad_Channels[i].mask) ? EVENT_LOAD_RESTORE : EVENT_LOAD_SHED);
+		load_outputs(outputs);
 	}
-
-	return;
+	return state.battery_low;
 }
 
 
-float battery_voltage_level()
+void load_outputs(uint8_t outputs)
 {
-	/* Read the ADC value from the BATTERY_LEVEL channel
-	 * and convert it to a range of (0V - 12V) equivalent
-	 * of the ADC reading (0V - 5V)
+	/* Switches all of the load channels in a single port write.
+	 * The TIMER1 ISR may switch the main load on the same port,
+	 * it must not run between the read and the write.
 	 */
-	return  (((float)ADC_read(BATTERY_LEVEL) * BATTERY_MAX_VOLTAGE) / 1023);
+	gLoad_Outputs = outputs;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		LOAD_PORT = (LOAD_PORT & ~LOAD_CHANNEL_MASK) | outputs;
+	}
+	return;
 }
 
 
-float soc_calculator()
+uint16_t battery_millivolts()
 {
-	//convert the battery voltage reading to a percentage value
-	return	((battery_voltage_level() / BATTERY_MAX_VOLTAGE) * 100.0);
+	/* Converts the ADC reading of the BATTERY_LEVEL channel
+	 * to a range of (0mV - 12000mV) with the calibration of
+	 * the unit
+	 */
+	return control_calibrate(&gCalibration, ADC_read(BATTERY_LEVEL));
 }
 
 
@@ -347,6 +528,7 @@ void led_display(float level)
 	 * to properly display the battery level
 	 * to the user
 	 */
+	PROF_ENTER(PROF_LED_DISPLAY);
 	if(level >= 85.0)
 	{
 		ENABLE_LED(PC0);
@@ -375,6 +557,62 @@ void led_display(float level)
 		DISABLE_LED(PC2);
 		ENABLE_LED(PC3);
 	}
+	PROF_EXIT(PROF_LED_DISPLAY);
+	return;
+}
+
+
+void dashboard_display()
+{
+	//the latest battery sample and the control state on the dashboard of screens.c
+	struct screen_status status = { gBattery_SOC, gBattery_Millivolts, gSOC_Limit, SCREEN_STATE_LOW, gLoad_Outputs };
+	if(gBattery_SOC >= gSOC_Limit)
+		status.state = gBattery_Charging ? SCREEN_STATE_CHARGING : gLoad_Supply_On ? SCREEN_STATE_LOAD_ON : SCREEN_STATE_LOAD_OFF;
+	screen_dashboard(&status);
+	return;
+}
+
+
+#ifdef PROFILING
+void profile_display()
+{
+	/* This routine writes the results of one profiling probe
+	 * to LCD, a different probe on every call. The first row
+	 * holds the probe name and the number of passes while the
+	 * second row holds the minimum, mean and maximum duration
+	 * (unit = us).
+	 */
+	static const char names[PROF_PROBES][9] PROGMEM = { "BATT MGR", "LEDS", "KEYPAD", "T1 ISR", "BACKGND" };
+	static uint8_t probe = 0;
+	struct prof_probe result;
+	prof_get(probe, &result);
+
+	//TIMER1 ticks are 8 CPU cycles, 1.5 ticks make a microsecond at 12MHz
+	uint32_t min = result.count ? result.min * 2 / 3 : 0;
+	uint32_t mean = result.count ? result.sum / result.count * 2 / 3 : 0;
+	uint32_t max = result.max * 2 / 3;
+
+	LCDClear();
+	lcd_set_cursor(0, 0);
+	lcd_printf_P(PSTR("%-8S n%-6u"), names[probe], result.count);
+	lcd_set_cursor(0, 1);
+	lcd_printf_P(PSTR("%lu %lu %lu"), (unsigned long)min, (unsigned long)mean, (unsigned long)max);
+
+	if(++probe == PROF_PROBES)
+		probe = 0;
+	return;
+}
+#endif
+
+
+void log_event(uint8_t code)
+{
+	//record a control event together with the latest SOC value
+	uint32_t now = millis();
+	uint8_t state = status_flags();
+	evlog_add(now, code, gBattery_SOC, state);
+	telemetry_send_event(now, code, gBattery_SOC);
+	warm_save();
 	return;
 }
 
@@ -386,33 +624,38 @@ void settings()
 	 * necessary sub-routine to handle user
 	 * options
 	 */
-	LCDClear();
-	LCDWriteStringXY(0, 0, "1. SET SOC LIMIT");
-	LCDWriteStringXY(0, 1, "2. SET TIMER (m)");
-	_delay_ms(300);
+	screen_prompt(gMsg_Menu_Soc_Limit, gMsg_Menu_Timer);
+	wait_ms(300);
+	screen_prompt(gMsg_Menu_Calibrate, NULL);
+	wait_ms(300);
 
-	LCDClear();
-	LCDWriteStringXY(0, 0, "PRESS # > CANCEL");
+	screen_prompt(gMsg_Press_Cancel, NULL);
 
 	char input = '\0';
 	input = scan_keypad_input(-1);
 	//# character input to cancel user selection
-	while(input != '1' && input != '2' && input != '#')
+	while(input != '1' && input != '2' && input != '3' && input != '#')
 		input = scan_keypad_input(-1);
 	switch(input)
 	{
 		case '1': {
-			LCDWriteStringXY(7, 1, "1");	//echo user input on LCD
+			screen_key(input);	//echo user input on LCD
 			_delay_ms(100);
 			set_soc_limit();
 			break;
 		}
 		case '2': {
-			LCDWriteStringXY(7, 1, "2");	//echo user input on LCD
+			screen_key(input);	//echo user input on LCD
 			_delay_ms(100);
 			set_countdown_time();
 			break;
 		}
+		case '3': {
+			screen_key(input);	//echo user input on LCD
+			_delay_ms(100);
+			set_calibration();
+			break;
+		}
 		case '#': break;
 	}
 	return;
@@ -425,8 +668,7 @@ void set_soc_limit()
 	 * of the SOC limit with the value provided
 	 * by the user
 	 */
-	LCDClear();
-	LCDWriteStringXY(0, 0, "SOC LIMIT VALUE:");
+	screen_prompt(gMsg_Soc_Limit_Value, NULL);
 
 	char input[3] = "\0\0\0";
 	int count = 0;
@@ -448,16 +690,14 @@ void set_soc_limit()
 
 		input[count++] = temp_input;
 
-		//echo user input to LCD
-		LCDWriteStringXY(0, 1, "                ");
-		LCDWriteStringXY(6, 1, input);
-		LCDWriteStringXY(6 + strlen(input), 1, "%        ");
+		screen_input(6, 1, input, gMsg_Percent);	//echo user input to LCD
 	}
 	while(count < 2);
 
 	_delay_ms(100);
 	input[count] = '\0';
 	gSOC_Limit = string_to_integer(input);
+	log_event(EVENT_SOC_LIMIT_SET);
 
 	return;
 }
@@ -469,9 +709,7 @@ void set_countdown_time()
 	 * of the count down time in minutes with
 	 * the value provided by the user
 	 */
-	LCDClear();
-	LCDWriteStringXY(0, 0, "PRESS # > CANCEL");
-	LCDWriteStringXY(0, 1, "HOLD * TO START");
+	screen_prompt(gMsg_Press_Cancel, gMsg_Hold_Start);
 
 	char input[4] = "\0\0\0\0";
 	int count = 0;
@@ -497,29 +735,98 @@ void set_countdown_time()
 			continue;
 		input[count++] = temp_input;
 
-		//echo user input to LCD
-		LCDWriteStringXY(0, 0, "                ");
-		LCDWriteStringXY(3, 0, input);
-		LCDWriteStringXY(3 + strlen(input), 0, " MIN(S)");
+		screen_input(3, 0, input, gMsg_Minutes);	//echo user input to LCD
 	}
 	while(count < 3);
 
 	_delay_ms(100);
 	input[count] = '\0';
-	gCountdown_Time = string_to_integer(input) - 1;
+	snapshot16_write(&gCountdown_Time, string_to_integer(input) - 1);
 	init_countdown();	//start the count down process
 
 	return;
 }
 
 
+void set_calibration()
+{
+	/* This routine runs the two point calibration of the
+	 * battery voltage reading. For each point the user applies
+	 * a voltage to the battery input, measures it with a
+	 * voltmeter and enters it in mV, the lower one first. The
+	 * gain and offset found are saved to EEPROM.
+	 */
+	uint16_t adc[2], millivolts[2];
+	for(uint8_t point = 0; point < 2; ++point)
+	{
+		screen_prompt(point ? gMsg_High_Point : gMsg_Low_Point, NULL);
+
+		char input[6] = "\0\0\0\0\0\0";
+		int count = 0;
+		char temp_input = '\0';
+		uint32_t value = 0;
+		do
+		{
+			temp_input = scan_keypad_input(-1);
+
+			//when the user wants to cancel the calibration
+			if(temp_input == '#')
+				return;
+
+			//let $ represent ** which takes the reading
+			if(temp_input == '$' && count > 0)
+				break;
+			if(temp_input < '0' || temp_input > '9')
+				continue;
+
+			//a digit that takes the reading above what can be calibrated is ignored, five digits would wrap 16 bits
+			if(value * 10 + (temp_input - '0') > CONTROL_CALIBRATION_MAX_MILLIVOLTS)
+				continue;
+			value = value * 10 + (temp_input - '0');
+			input[count++] = temp_input;
+
+			screen_input(5, 1, input, gMsg_Millivolts);	//echo user input to LCD
+		}
+		while(count < 5);
+
+		input[count] = '\0';
+		millivolts[point] = value;
+
+		//average a few readings, the voltage has been applied while the user was typing
+		uint16_t sum = 0;
+		for(uint8_t i = 0; i < CALIBRATION_SAMPLES; ++i)
+			sum += ADC_read(BATTERY_LEVEL);
+		adc[point] = (sum + CALIBRATION_SAMPLES / 2) / CALIBRATION_SAMPLES;
+	}
+
+	if(!control_calibration_fit(&gCalibration, adc[0], millivolts[0], adc[1], millivolts[1]))
+	{
+		screen_prompt(gMsg_Cal_Failed, NULL);
+		wait_ms(1000);
+		return;
+	}
+	while(!config_save_calibration(&gCalibration))
+		background_tasks();
+	log_event(EVENT_CALIBRATED);
+	screen_prompt(gMsg_Calibrated, NULL);
+	wait_ms(1000);
+	return;
+}
+
+
 void setup_timer1()
 {
-	/* use a prescaling of 64 (CLK = 12MHz / 64 = 187500Hz)
+	/* use a prescaling of 8 (CLK = 12MHz / 8 = 1500000Hz)
 	 * Use CTC mode (clear timer on compare match)
 	 */
-	TCCR1B = (1 << WGM12) | (1 << CS11) | (1<<CS10);
-	OCR1A = 16;	//compare value (count from 0 - 16 and then reset to 0)
+	TCCR1B = (1 << WGM12) | (1 << CS11);
+	OCR1A = 1499;	//compare value (count from 0 - 1499 and then reset to 0, i.e every 1ms)
+
+	/* the Output Compare A interrupt is always enabled since it also
+	 * serves as the system tick. The count down itself is only
+	 * decremented while gCountdown_Running is set.
+	 */
+	TIMSK |= (1 << OCIE1A);
 
 	sei();	//enable global interrupts
 
@@ -527,6 +834,33 @@ void setup_timer1()
 }
 
 
+uint16_t boot_micros()
+{
+	/* Time elapsed since TIMER1 was started (unit = us). Only
+	 * used to time the boot, it wraps around after 65ms.
+	 */
+	uint32_t now;
+	uint16_t ticks;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		now = gMillis.value;
+		ticks = TCNT1;
+		//a compare match that hasn't been serviced yet
+		if((TIFR & (1 << OCF1A)) && ticks < 1499)
+			++now;
+	}
+	//TIMER1 runs at 1.5MHz, 1.5 ticks per us
+	return (now - gBoot_Millis) * 1000 + (ticks * 2) / 3;
+}
+
+
+uint32_t millis()
+{
+	//the 32 bit tick count is updated by the TIMER1 ISR so it can't be read in a single instruction
+	return snapshot32_read(&gMillis);
+}
+
+
 void init_countdown()
 {
 	/* This routine handles every that has to do with starting
@@ -537,40 +871,65 @@ void init_countdown()
 	 */
 	gMilli_Seconds = 0;
 	gSeconds_Count = 59;
-
-	//get the number of hours from the user specified count down time which was give in minutes
-	uint16_t hours = gCountdown_Time / 60;
-	//get the corresponding number of minutes to tally with the number of hours calculated
-	uint16_t mins = gCountdown_Time % 60;
+	struct countdown_tick tick;
+	while(countdown_queue_pop(&gCountdown_Ticks, &tick));	//drop what is left of a previous count down
 
 	//write the initial values to LCD before the TIMER1 circuit is started
-	LCDClear();
-	LCDWriteIntXY(4, 0, hours, 2);
-	LCDWriteStringXY(6, 0, ":");
-	LCDWriteIntXY(7, 0, mins, 2);
-	LCDWriteStringXY(9, 0, ":");
-	LCDWriteIntXY(10, 0, gSeconds_Count, 2);
-
-	LCDWriteStringXY(4, 1, "HH:");
-	LCDWriteStringXY(7, 1, "MM:");
-	LCDWriteStringXY(10, 1, "SS");
+	if(lcd_ready())
+		screen_countdown(snapshot16_read(&gCountdown_Time), shared_load8(&gSeconds_Count));
 	gCountdown_In_Progress = TRUE;
 
-	//Enable the Output Compare A interrupt
-	TIMSK |= (1 << OCIE1A);
+	//let the TIMER1 ISR start decrementing the count down, this hands the values above over to it
+	shared_store8(&gCountdown_Running, TRUE);
+	log_event(EVENT_COUNTDOWN_START);
 
 	return;
 }
 
 
+void countdown_expired()
+{
+	/* Completes a count down that has been expired by the
+	 * TIMER1 ISR, which has already disconnected the load.
+	 * It waits for a user interaction indicating a cancel
+	 * operation.
+	 */
+	log_event(EVENT_COUNTDOWN_END);
+	screen_countdown_expired();
+	while(scan_keypad_input(-1) != '#');	//loop until user presses # to cancel the whole operation
+	shared_store8(&gCountdown_Expired, FALSE);	//the ISR has stopped, it is the main loop's flag again
+	gCountdown_In_Progress = FALSE;
+	gDashboard_Shown = FALSE;
+	return;
+}
+
+
 void terminate_countdown()
 {
 	LOAD_SUPPLY_OFF;
 	gLoad_Supply_On = FALSE;
 
-	//Disable the output compare A interrupt
-	TIMSK &= ~(1 << OCIE1A);
+	//stop the TIMER1 ISR from decrementing the count down
+	shared_store8(&gCountdown_Running, FALSE);
+	log_event(EVENT_COUNTDOWN_END);
+
+	return;
+}
+
 
+void countdown_poll()
+{
+	/* Shows the time left queued by the TIMER1 ISR. The hours
+	 * and minutes only change when the seconds start over at
+	 * 59, the seconds are written on every tick.
+	 */
+	struct countdown_tick tick;
+	while(countdown_queue_pop(&gCountdown_Ticks, &tick))
+	{
+		if(!lcd_ready() || !gCountdown_In_Progress)
+			continue;
+		screen_countdown_tick(tick.minutes, tick.seconds);
+	}
 	return;
 }
 
@@ -578,13 +937,23 @@ void terminate_countdown()
 ISR(TIMER1_COMPA_vect)
 {
 	/* TIMER1 Interrupt handler. Used to decrement
-	 * the gCountdown_Time as well as display the
-	 * progress on LCD. It counts down at a rate of
+	 * the gCountdown_Time as well as queue the
+	 * progress for the LCD. It counts down at a rate of
 	 * 1 second in real-time. Some logic and calculation
 	 * aids us to achieve this since the TIMER1 (16-bit)
 	 * circuit can't give us the exact resolution needed
 	 * to overflow every 1 second in real time.
+	 * It also keeps the system tick used for time keeping.
 	 */
+	snapshot32_write(&gMillis, gMillis.value + 1);
+	PROF_ENTER(PROF_TIMER1_ISR);	//only once the system tick is up to date, see prof_now
+
+	if(!shared_load8(&gCountdown_Running))
+	{
+		PROF_EXIT(PROF_TIMER1_ISR);
+		return;
+	}
+
 	++gMilli_Seconds;
 
 	if(gMilli_Seconds == 1000)
@@ -592,45 +961,39 @@ ISR(TIMER1_COMPA_vect)
 		/* This block handles seconds count down when
 		 * 1000 milliseconds has been reached
 		 */
-		--gSeconds_Count;
-		LCDWriteIntXY(10, 0, gSeconds_Count, 2);
+		struct countdown_tick tick = { gCountdown_Time.value, gSeconds_Count - 1 };
+		shared_store8(&gSeconds_Count, tick.seconds);
+		countdown_queue_push(&gCountdown_Ticks, &tick);	//a tick is dropped when the main loop is behind, the next one catches up
 		gMilli_Seconds = 0;
 	}
 
 	if(gSeconds_Count == 0)
 	{
-		if(gCountdown_Time == 0)
+		if(gCountdown_Time.value == 0)
 		{
 			/* This terminates the count down sequence and
-			 * disconnects the load from the battery as it
-			 * infinitely waits for a user interaction
-			 * indicating a cancel operation.
+			 * disconnects the load from the battery right
+			 * away. Waiting for the user to cancel the
+			 * operation is left to the main loop, an ISR
+			 * must never block.
 			 */
-			terminate_countdown();
-			LCDWriteStringXY(0, 1, "PRESS # TO STOP");
-			while(scan_keypad_input(-1) != '#');	//loop until user presses # to cancel the whole operation
-			gCountdown_In_Progress = FALSE;
+			LOAD_SUPPLY_OFF;
+			shared_store8(&gLoad_Supply_On, FALSE);
+			shared_store8(&gCountdown_Running, FALSE);
+			shared_store8(&gCountdown_Expired, TRUE);
 		}
 		else
 		{
 			/* This block handles minute count down
 			 * when  60 seconds has been reached
 			 */
-			--gCountdown_Time;
-			gSeconds_Count = 59;
-
-			//get the number of hours from the user specified count down time which was give in minutes
-			uint16_t hours = gCountdown_Time / 60;
-			//get the corresponding number of minutes to tally with the number of hours calculated
-			uint16_t mins = gCountdown_Time % 60;
-
-			//write the hours, minutes and seconds values to LCD
-			LCDWriteIntXY(4, 0, hours, 2);
-			LCDWriteIntXY(7, 0, mins, 2);
-			LCDWriteIntXY(10, 0, gSeconds_Count, 2);
-
+			struct countdown_tick tick = { gCountdown_Time.value - 1, 59 };
+			snapshot16_write(&gCountdown_Time, tick.minutes);
+			shared_store8(&gSeconds_Count, tick.seconds);
+			countdown_queue_push(&gCountdown_Ticks, &tick);
 		}
 	}
+	PROF_EXIT(PROF_TIMER1_ISR);
 	return;
 }
 
@@ -644,6 +1007,7 @@ char scan_keypad_input(int16_t cycles)
 	/* Need to handle situations where the number of cycles given
 	 * is less than 0 which indicates an unlimited number of cycles
 	 */
+	PROF_ENTER(PROF_KEYPAD);
 	int16_t count = (cycles < 0)? (-1 * cycles) : cycles;
 	char input = '\0';
 
@@ -655,7 +1019,8 @@ char scan_keypad_input(int16_t cycles)
 			if(MATRIX_KEYPAD_INPUT_ENABLED(PB4))
 			{
 				//keep on looping until user releases key
-				while(MATRIX_KEYPAD_INPUT_ENABLED(PB4));
+				while(MATRIX_KEYPAD_INPUT_ENABLED(PB4))
+					background_tasks();
 				input = '1';
 				MATRIX_KEYPAD_OUTPUT_DISABLE(PB0);
 				break;
@@ -663,7 +1028,8 @@ char scan_keypad_input(int16_t cycles)
 			else if(MATRIX_KEYPAD_INPUT_ENABLED(PB5))
 			{
 				//keep on looping until user releases key
-				while(MATRIX_KEYPAD_INPUT_ENABLED(PB5));
+				while(MATRIX_KEYPAD_INPUT_ENABLED(PB5))
+					background_tasks();
 				input = '2';
 				MATRIX_KEYPAD_OUTPUT_DISABLE(PB0);
 				break;
@@ -671,7 +1037,8 @@ char scan_keypad_input(int16_t cycles)
 			else if(MATRIX_KEYPAD_INPUT_ENABLED(PB6))
 			{
 				//keep on looping until user releases key
-				while(MATRIX_KEYPAD_INPUT_ENABLED(PB6));
+				while(MATRIX_KEYPAD_INPUT_ENABLED(PB6))
+					background_tasks();
 				input = '3';
 				MATRIX_KEYPAD_OUTPUT_DISABLE(PB0);
 				break;
@@ -685,7 +1052,8 @@ char scan_keypad_input(int16_t cycles)
 			if(MATRIX_KEYPAD_INPUT_ENABLED(PB4))
 			{
 				//keep on looping until user releases key
-				while(MATRIX_KEYPAD_INPUT_ENABLED(PB4));
+				while(MATRIX_KEYPAD_INPUT_ENABLED(PB4))
+					background_tasks();
 				input = '4';
 				MATRIX_KEYPAD_OUTPUT_DISABLE(PB1);
 				break;
@@ -693,7 +1061,8 @@ char scan_keypad_input(int16_t cycles)
 			else if(MATRIX_KEYPAD_INPUT_ENABLED(PB5))
 			{
 				//keep on looping until user releases key
-				while(MATRIX_KEYPAD_INPUT_ENABLED(PB5));
+				while(MATRIX_KEYPAD_INPUT_ENABLED(PB5))
+					background_tasks();
 				input = '5';
 				MATRIX_KEYPAD_OUTPUT_DISABLE(PB1);
 				break;
@@ -701,7 +1070,8 @@ char scan_keypad_input(int16_t cycles)
 			else if(MATRIX_KEYPAD_INPUT_ENABLED(PB6))
 			{
 				//keep on looping until user releases key
-				while(MATRIX_KEYPAD_INPUT_ENABLED(PB6));
+				while(MATRIX_KEYPAD_INPUT_ENABLED(PB6))
+					background_tasks();
 				input = '6';
 				MATRIX_KEYPAD_OUTPUT_DISABLE(PB1);
 				break;
@@ -715,7 +1085,8 @@ char scan_keypad_input(int16_t cycles)
 			if(MATRIX_KEYPAD_INPUT_ENABLED(PB4))
 			{
 				//keep on looping until user releases key
-				while(MATRIX_KEYPAD_INPUT_ENABLED(PB4));
+				while(MATRIX_KEYPAD_INPUT_ENABLED(PB4))
+					background_tasks();
 				input = '7';
 				MATRIX_KEYPAD_OUTPUT_DISABLE(PB2);
 				break;
@@ -723,7 +1094,8 @@ char scan_keypad_input(int16_t cycles)
 			else if(MATRIX_KEYPAD_INPUT_ENABLED(PB5))
 			{
 				//keep on looping until user releases key
-				while(MATRIX_KEYPAD_INPUT_ENABLED(PB5));
+				while(MATRIX_KEYPAD_INPUT_ENABLED(PB5))
+					background_tasks();
 				input = '8';
 				MATRIX_KEYPAD_OUTPUT_DISABLE(PB2);
 				break;
@@ -731,7 +1103,8 @@ char scan_keypad_input(int16_t cycles)
 			else if(MATRIX_KEYPAD_INPUT_ENABLED(PB6))
 			{
 				//keep on looping until user releases key
-				while(MATRIX_KEYPAD_INPUT_ENABLED(PB6));
+				while(MATRIX_KEYPAD_INPUT_ENABLED(PB6))
+					background_tasks();
 				input = '9';
 				MATRIX_KEYPAD_OUTPUT_DISABLE(PB2);
 				break;
@@ -760,7 +1133,8 @@ char scan_keypad_input(int16_t cycles)
 			else if(MATRIX_KEYPAD_INPUT_ENABLED(PB5))
 			{
 				//keep on looping until user releases key
-				while(MATRIX_KEYPAD_INPUT_ENABLED(PB5));
+				while(MATRIX_KEYPAD_INPUT_ENABLED(PB5))
+					background_tasks();
 				input = '0';
 				MATRIX_KEYPAD_OUTPUT_DISABLE(PB3);
 				break;
@@ -768,7 +1142,8 @@ char scan_keypad_input(int16_t cycles)
 			else if(MATRIX_KEYPAD_INPUT_ENABLED(PB6))
 			{
 				//keep on looping until user releases key
-				while(MATRIX_KEYPAD_INPUT_ENABLED(PB6));
+				while(MATRIX_KEYPAD_INPUT_ENABLED(PB6))
+					background_tasks();
 				input = '#';
 				MATRIX_KEYPAD_OUTPUT_DISABLE(PB3);
 				break;
@@ -777,10 +1152,14 @@ char scan_keypad_input(int16_t cycles)
 		}
 		_delay_ms(0.1);
 
+		//keep the background tasks running while waiting for user input
+		background_tasks();
+
 		//only decrement count if number of cycles is finite
 		if(cycles > 0)
 			--count;
 	}
+	PROF_EXIT(PROF_KEYPAD);
 	return input;
 }
 
@@ -791,7 +1170,9 @@ void central_hub()
 	 * from battery management to user input
 	 * settings
 	 */
-	battery_manager();
+	if(shared_load8(&gCountdown_Expired))
+		countdown_expired();
+
 	if(!gCountdown_In_Progress)
 	{
 		/* In other to avoid interrupting the count
@@ -800,13 +1181,315 @@ void central_hub()
 		 * trying to ask for user input to the SOC limit
 		 * and count down time settings
 		 */
-		LCDClear();
-		LCDWriteStringXY(0, 0, "PRESS * > OPTION");
+		battery_display();
 
-		//wait 5 cycles for user input before continuing execution
-		char input = scan_keypad_input(5000);	//wait for user input for 5 seconds
+		//a single pass over the keypad, which also runs the background tasks
+		char input = scan_keypad_input(1);
 		if(input == '*')
+		{
 			settings();
+			gDashboard_Shown = FALSE;
+		}
+	}
+	else
+		background_tasks();
+
+	//the battery is sampled by the background tasks, nothing is due before the next system tick
+	idle();
+	return;
+}
+
+
+void background_tasks()
+{
+	/* Runs the work that has to keep going while the
+	 * main loop is busy showing a page or waiting for user
+	 * input. It must return quickly since it is called from
+	 * every wait loop.
+	 */
+	PROF_ENTER(PROF_BACKGROUND);
+	uint32_t now = millis();
+
+	//a hang anywhere that doesn't run the background tasks resets the module
+	wdt_reset();
+
+	countdown_poll();
+
+	//sample the battery and take the control decisions, at a rate set by battery_manager
+	static uint32_t battery_next;
+	if((int32_t)(now - battery_next) >= 0)
+		battery_next = now + battery_manager();
+
+	//track how close the stack and the heap have come to each other
+	static uint32_t memwatch_next;
+	if((int32_t)(now - memwatch_next) >= 0)
+	{
+		memwatch_next = now + MEMWATCH_PERIOD;
+		memwatch_scan();
+	}
+
+	//the battery is only sampled by battery_manager, the telemetry and the datalog report its latest sample
+	if(telemetry_due(now))
+		telemetry_send_snapshot(now, gBattery_Millivolts, gBattery_SOC, gSOC_Limit, status_flags(),
+				snapshot16_read(&gCountdown_Time));
+
+#ifdef MODBUS_SLAVE
+	modbus_poll();
+#else
+	telemetry_poll();
+#endif
+	evlog_poll();
+
+	//battery history in the serial flash, an uncalibrated ADC reading packs better than millivolts
+	static uint32_t datalog_next;
+	if((int32_t)(now - datalog_next) >= 0)
+	{
+		datalog_next = now + DATALOG_PERIOD;
+		datalog_add(now, control_adc(gBattery_Millivolts), status_flags());
+	}
+	datalog_poll();
+
+	save_settings();
+	config_poll();
+	PROF_EXIT(PROF_BACKGROUND);
+	return;
+}
+
+
+void wait_ms(uint16_t duration)
+{
+	//same as _delay_ms but keeps the background tasks running
+	uint32_t start = millis();
+	while(millis() - start < duration)
+	{
+		background_tasks();
+		idle();
+	}
+	return;
+}
+
+
+void idle()
+{
+	/* Stops the CPU until the next interrupt, the system tick
+	 * of TIMER1 at the latest. A flag set by an interrupt just
+	 * before the CPU is stopped is seen 1ms later.
+	 */
+	sleep_mode();
+	return;
+}
+
+
+uint8_t status_flags()
+{
+	//pack the state of the module into the status flags of a snapshot frame
+	uint8_t flags = 0;
+	if(gLoad_Supply_On)
+		flags |= FRAME_FLAG_LOAD_ON;
+	if(gBattery_Charging)
+		flags |= FRAME_FLAG_CHARGING;
+	if(gBuzzer_On)
+		flags |= FRAME_FLAG_BUZZER_ON;
+	if(EXTERNAL_POWER_AVAILABLE)
+		flags |= FRAME_FLAG_EXTERNAL_POWER;
+	if(gCountdown_In_Progress)
+		flags |= FRAME_FLAG_COUNTDOWN;
+	return flags;
+}
+
+
+uint8_t modbus_read_register(uint16_t address, uint16_t *value)
+{
+	/* Maps the Modbus registers onto the live state of the
+	 * module. Only cached values are used so that a request
+	 * never has to wait for an ADC conversion.
+	 */
+	const struct battery_stats* stats = stats_get();
+	switch(address)
+	{
+		case MODBUS_REG_SOC: *value = gBattery_SOC; break;
+		case MODBUS_REG_MILLIVOLTS: *value = gBattery_Millivolts; break;
+		case MODBUS_REG_STATUS: *value = status_flags(); break;
+		case MODBUS_REG_SOC_LIMIT: *value = gSOC_Limit; break;
+		case MODBUS_REG_LOAD_OUTPUTS: {
+			*value = 0;
+			for(uint8_t i = 0; i < LOAD_CHANNEL_COUNT; ++i)
+				if(gLoad_Outputs & gLoad_Channels[i].mask)
+					*value |= 1 << i;
+			break;
+		}
+		case MODBUS_REG_COUNTDOWN: *value = gCountdown_In_Progress ? snapshot16_read(&gCountdown_Time) : 0; break;
+		case MODBUS_REG_MIN_MILLIVOLTS: *value = stats->samples ? stats->min_millivolts : 0; break;
+		case MODBUS_REG_MAX_MILLIVOLTS: *value = stats->max_millivolts; break;
+		case MODBUS_REG_MEAN_MILLIVOLTS: *value = stats_mean_millivolts(); break;
+		case MODBUS_REG_CUTOFFS: *value = stats->cutoffs; break;
+		case MODBUS_REG_CHARGE_CYCLES: *value = stats->charge_cycles; break;
+		case MODBUS_REG_ENERGY_HIGH: *value = stats->milli_watt_hours >> 16; break;
+		case MODBUS_REG_ENERGY_LOW: *value = stats->milli_watt_hours; break;
+		case MODBUS_REG_LOW_TIME_HIGH: *value = stats->low_seconds >> 16; break;
+		case MODBUS_REG_LOW_TIME_LOW: *value = stats->low_seconds; break;
+		case MODBUS_REG_ADDRESS: *value = modbus_address(); break;
+		case MODBUS_REG_BOOT_TIME: *value = gBoot_Protect_Time; break;
+		default: return MODBUS_ILLEGAL_ADDRESS;
+	}
+	return MODBUS_OK;
+}
+
+
+uint8_t modbus_write_register(uint16_t address, uint16_t value)
+{
+	switch(address)
+	{
+		case MODBUS_REG_SOC_LIMIT: {
+			if(value == 0 || value > 99)
+				return MODBUS_ILLEGAL_VALUE;
+			gSOC_Limit = value;
+			log_event(EVENT_SOC_LIMIT_SET);
+			break;
+		}
+		case MODBUS_REG_ADDRESS: {
+			if(value == MODBUS_BROADCAST || value > 247)
+				return MODBUS_ILLEGAL_VALUE;
+			modbus_set_address(value);
+			break;
+		}
+		default: {
+			//a register that exists but can't be written is reported as an illegal address as well
+			return MODBUS_ILLEGAL_ADDRESS;
+		}
+	}
+	return MODBUS_OK;
+}
+
+
+void restore_settings()
+{
+	struct config_data config;
+	if(!config_load(&config))
+		return;	//nothing saved yet, keep the defaults
+
+	gSOC_Limit = config.soc_limit;
+	if(config.modbus_address != MODBUS_BROADCAST && config.modbus_address <= 247)
+		modbus_set_address(config.modbus_address);
+	if(config.countdown_active)
+	{
+		/* resume the count down from the last saved minute. The
+		 * load is only reconnected if it was connected when the
+		 * power went off, battery_protect disconnects it again
+		 * if the battery is low.
+		 */
+		if(config.load_on)
+		{
+			LOAD_SUPPLY_ON;
+			gLoad_Supply_On = TRUE;
+		}
+		snapshot16_write(&gCountdown_Time, config.countdown_time);
+		init_countdown();
+	}
+	return;
+}
+
+
+void save_settings()
+{
+	/* Stages the current settings for saving. Only the count
+	 * down minutes are saved, saving every second would wear
+	 * out the EEPROM. Nothing is written unless a value has
+	 * changed.
+	 */
+	struct config_data config;
+	config.soc_limit = gSOC_Limit;
+	config.modbus_address = modbus_address();
+	config.countdown_time = snapshot16_read(&gCountdown_Time);
+	config.countdown_active = gCountdown_In_Progress;
+	config.load_on = gLoad_Supply_On;
+	if(!config.countdown_active)
+	{
+		//the rest only matters for resuming a count down, don't save every load change
+		config.countdown_time = 0;
+		config.load_on = FALSE;
+	}
+	config_save(&config);
+	return;
+}
+
+
+uint8_t warm_restore(uint8_t reset_cause)
+{
+	/* Resumes the control state kept in .noinit RAM after a
+	 * watchdog, brown-out or external reset so neither the
+	 * settings have to be read from EEPROM nor a new battery
+	 * sample has to be taken before the actuators are driven
+	 * again. A power-on reset or a bad CRC means a cold boot,
+	 * FALSE is returned then.
+	 */
+	struct warm_state *state = &gWarm_State;
+	if(reset_cause & (1 << PORF) || !(reset_cause & ((1 << WDRF) | (1 << BORF) | (1 << EXTRF))))
+		return FALSE;
+	if(state->magic != WARM_STATE_MAGIC
+			|| crc16((const uint8_t*)state, sizeof(*state) - sizeof(state->crc)) != state->crc)
+		return FALSE;
+
+	gSOC_Limit = state->soc_limit;
+	modbus_set_address(state->modbus_address);
+	gBattery_Millivolts = state->millivolts;
+	gBattery_SOC = state->soc;
+	snapshot16_write(&gCountdown_Time, state->countdown_time);
+	gSeconds_Count = state->seconds_count;
+	gMilli_Seconds = state->milli_seconds;
+	gCountdown_Expired = state->countdown_expired;
+	gCountdown_In_Progress = state->countdown_in_progress;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		//the ISR is the writer of the tick, it can't run while the main loop writes it here
+		gBoot_Millis = state->millis - gMillis.value;	//boot_micros keeps timing from TIMER1 start-up
+		snapshot32_write(&gMillis, state->millis);
+	}
+	shared_store8(&gCountdown_Running, state->countdown_running);
+
+	if(state->load_on)
+	{
+		LOAD_SUPPLY_ON;
+		gLoad_Supply_On = TRUE;
+	}
+	if(state->charging)
+	{
+		BATTERY_CHARGE_ON;
+		gBattery_Charging = TRUE;
+	}
+	if(state->buzzer_on)
+	{
+		BUZZER_ON;
+		gBuzzer_On = TRUE;
+	}
+	load_outputs(state->load_outputs & LOAD_CHANNEL_MASK);
+	return TRUE;
+}
+
+
+void warm_save()
+{
+	struct warm_state *state = &gWarm_State;
+	state->magic = WARM_STATE_MAGIC;
+	state->load_on = gLoad_Supply_On;
+	state->charging = gBattery_Charging;
+	state->buzzer_on = gBuzzer_On;
+	state->load_outputs = gLoad_Outputs;
+	state->countdown_in_progress = gCountdown_In_Progress;
+	state->soc_limit = gSOC_Limit;
+	state->millivolts = gBattery_Millivolts;
+	state->soc = gBattery_SOC;
+	state->modbus_address = modbus_address();
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		//the count down is updated by the TIMER1 ISR, take a consistent copy of all of it at once
+		state->countdown_running = gCountdown_Running;
+		state->countdown_expired = gCountdown_Expired;
+		state->countdown_time = gCountdown_Time.value;
+		state->seconds_count = gSeconds_Count;
+		state->milli_seconds = gMilli_Seconds;
+		state->millis = gMillis.value;
 	}
+	state->crc = crc16((const uint8_t*)state, sizeof(*state) - sizeof(state->crc));
 	return;
 }
@@ -0,0 +1,83 @@
+/*
+ * memwatch.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include <avr/io.h>
+#include "memwatch.h"
+
+//provided by the linker script
+extern uint8_t __heap_start;	//end of .noinit, _end in the painting code
+extern uint8_t __data_start;
+
+static struct memwatch memwatch = { 0, 0, 0, UINT16_MAX };
+static const uint8_t *heap_top;	//first byte above the heap high-water mark, NULL before the first scan
+static const uint8_t *stack_bottom;	//deepest byte the stack has used
+
+void memwatch_paint(void) __attribute__((naked, used, section(".init1")));
+
+
+void memwatch_paint(void)
+{
+	/* Runs from .init1, before the stack pointer and the zero
+	 * register have been set up, so it can't be C code. Paints
+	 * everything from _end up to RAMEND, the stack is still
+	 * empty at this point.
+	 */
+	__asm__ __volatile__(
+			"	ldi r30, lo8(_end)\n"
+			"	ldi r31, hi8(_end)\n"
+			"	ldi r24, %0\n"
+			"	ldi r25, hi8(%1)\n"
+			"	rjmp 2f\n"
+			"1:	st Z+, r24\n"
+			"2:	cpi r30, lo8(%1)\n"
+			"	cpc r31, r25\n"
+			"	brlo 1b\n"
+			"	breq 1b\n"
+			:: "M" (MEMWATCH_PAINT), "i" (RAMEND));
+}
+
+
+static uint8_t memwatch_painted(const uint8_t *p)
+{
+	//MEMWATCH_GUARD bytes of paint from p on, a shorter run is a hole in the heap or the stack
+	for(uint8_t i = 0; i < MEMWATCH_GUARD; ++i)
+		if(p[i] != MEMWATCH_PAINT)
+			return 0;
+	return 1;
+}
+
+
+void memwatch_scan(void)
+{
+	/* Moves the heap and stack high-water marks on from where
+	 * the previous scan left them. A byte that has been used is
+	 * never painted again, so only the bytes used since then are
+	 * read. A walk over the whole free SRAM, about 2ms of main
+	 * loop time at 12MHz, is only ever done by a unit that is
+	 * running out of it.
+	 */
+	if(!heap_top)
+	{
+		heap_top = &__heap_start;
+		stack_bottom = (const uint8_t*)SP + 1;	//SP points below the top of the stack
+	}
+	while(heap_top + MEMWATCH_GUARD <= stack_bottom && !memwatch_painted(heap_top))
+		++heap_top;
+	while(stack_bottom - MEMWATCH_GUARD >= heap_top && !memwatch_painted(stack_bottom - MEMWATCH_GUARD))
+		--stack_bottom;
+
+	memwatch.static_size = &__heap_start - &__data_start;
+	memwatch.heap_max = heap_top - &__heap_start;
+	memwatch.stack_max = RAMEND + 1 - (uint16_t)stack_bottom;
+	memwatch.free_min = stack_bottom - heap_top;
+	return;
+}
+
+
+const struct memwatch* memwatch_get(void)
+{
+	return &memwatch;
+}
@@ -0,0 +1,35 @@
+/*
+ * memwatch.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef MEMWATCH_H_
+#define MEMWATCH_H_
+
+#include <stdint.h>
+
+/* SRAM high-water marks. The RAM between the static data and
+ * the top of the stack is painted before the C start-up code
+ * runs, every scan then moves the top of the heap up and the
+ * bottom of the stack down over the bytes that have lost their
+ * paint since. A scan only costs as much as the heap and the
+ * stack have grown. All sizes are in bytes.
+ */
+#define MEMWATCH_PAINT 0xC5
+#define MEMWATCH_PERIOD 1000	//time between two scans (unit = ms)
+#define MEMWATCH_GUARD 8	//bytes of paint in a row that end the heap or the stack
+
+struct memwatch
+{
+	uint16_t static_size;	//.data, .bss and .noinit
+	uint16_t heap_max;	//deepest the heap has grown
+	uint16_t stack_max;	//deepest the stack has grown, ISRs included
+	uint16_t free_min;	//smallest gap ever left between the heap and the stack
+};
+
+void memwatch_scan(void);
+const struct memwatch* memwatch_get(void);
+
+#endif /* MEMWATCH_H_ */
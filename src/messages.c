@@ -0,0 +1,29 @@
+/*
+ * messages.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include "messages.h"
+
+const char gMsg_Battery_Low[] PROGMEM = "BATTERY LOW";
+const char gMsg_Batt_Charging[] PROGMEM = "BATT CHARGING";
+const char gMsg_Load_On[] PROGMEM = "LOAD ON";
+const char gMsg_Load_Off[] PROGMEM = "LOAD OFF";
+const char gMsg_Soc[] PROGMEM = "SOC = ";
+const char gMsg_Menu_Soc_Limit[] PROGMEM = "1. SET SOC LIMIT";
+const char gMsg_Menu_Timer[] PROGMEM = "2. SET TIMER (m)";
+const char gMsg_Menu_Calibrate[] PROGMEM = "3. CALIBRATE";
+const char gMsg_Press_Cancel[] PROGMEM = "PRESS # > CANCEL";
+const char gMsg_Soc_Limit_Value[] PROGMEM = "SOC LIMIT VALUE:";
+const char gMsg_Blank_Row[] PROGMEM = "                ";	//clears a row of the LCD
+const char gMsg_Percent[] PROGMEM = "%        ";	//also clears what is left of the row
+const char gMsg_Hold_Start[] PROGMEM = "HOLD * TO START";
+const char gMsg_Minutes[] PROGMEM = " MIN(S)";
+const char gMsg_Low_Point[] PROGMEM = "LOW POINT (mV):";
+const char gMsg_High_Point[] PROGMEM = "HIGH POINT (mV):";
+const char gMsg_Millivolts[] PROGMEM = "mV";
+const char gMsg_Cal_Failed[] PROGMEM = "CAL FAILED";
+const char gMsg_Calibrated[] PROGMEM = "CALIBRATED";
+const char gMsg_Countdown_Units[] PROGMEM = "HH:MM:SS";
+const char gMsg_Press_Stop[] PROGMEM = "PRESS # TO STOP";
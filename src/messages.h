@@ -0,0 +1,40 @@
+/*
+ * messages.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef MESSAGES_H_
+#define MESSAGES_H_
+
+#include "pgm.h"
+
+/* The text shown on the LCD. The strings are kept in flash so
+ * they aren't copied to SRAM by the C start-up code, they are
+ * written with lcd_puts_P or LCDWriteStringXY_P. A string used on
+ * several screens is only stored once.
+ */
+extern const char gMsg_Battery_Low[] PROGMEM;
+extern const char gMsg_Batt_Charging[] PROGMEM;
+extern const char gMsg_Load_On[] PROGMEM;
+extern const char gMsg_Load_Off[] PROGMEM;
+extern const char gMsg_Soc[] PROGMEM;
+extern const char gMsg_Menu_Soc_Limit[] PROGMEM;
+extern const char gMsg_Menu_Timer[] PROGMEM;
+extern const char gMsg_Menu_Calibrate[] PROGMEM;
+extern const char gMsg_Press_Cancel[] PROGMEM;
+extern const char gMsg_Soc_Limit_Value[] PROGMEM;
+extern const char gMsg_Blank_Row[] PROGMEM;
+extern const char gMsg_Percent[] PROGMEM;
+extern const char gMsg_Hold_Start[] PROGMEM;
+extern const char gMsg_Minutes[] PROGMEM;
+extern const char gMsg_Low_Point[] PROGMEM;
+extern const char gMsg_High_Point[] PROGMEM;
+extern const char gMsg_Millivolts[] PROGMEM;
+extern const char gMsg_Cal_Failed[] PROGMEM;
+extern const char gMsg_Calibrated[] PROGMEM;
+extern const char gMsg_Countdown_Units[] PROGMEM;
+extern const char gMsg_Press_Stop[] PROGMEM;
+
+#endif /* MESSAGES_H_ */
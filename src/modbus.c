@@ -0,0 +1,167 @@
+/*
+ * modbus.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include "modbus.h"
+#include "crc.h"
+
+static uint8_t slave_address;
+
+
+void modbus_init(uint8_t address)
+{
+	slave_address = address;
+	return;
+}
+
+
+void modbus_set_address(uint8_t address)
+{
+	slave_address = address;
+	return;
+}
+
+
+uint8_t modbus_address(void)
+{
+	return slave_address;
+}
+
+
+static inline uint16_t get16(const uint8_t *p)
+{
+	//Modbus sends its 16 bit fields big endian
+	return ((uint16_t)p[0] << 8) | p[1];
+}
+
+
+static inline uint8_t* put16(uint8_t *p, uint16_t value)
+{
+	p[0] = value >> 8;
+	p[1] = value;
+	return p + 2;
+}
+
+
+static uint8_t read_registers(const uint8_t *request, uint8_t length, uint8_t *response)
+{
+	if(length != 6)
+		return MODBUS_ILLEGAL_VALUE;
+	uint16_t start = get16(request + 2);
+	uint16_t count = get16(request + 4);
+	if(count == 0 || count > MODBUS_MAX_REGISTERS)
+		return MODBUS_ILLEGAL_VALUE;
+
+	uint8_t *p = response + 3;
+	for(uint16_t i = 0; i < count; ++i)
+	{
+		uint16_t value;
+		uint8_t status = modbus_read_register(start + i, &value);
+		if(status != MODBUS_OK)
+			return status;
+		p = put16(p, value);
+	}
+	response[2] = count * 2;
+	return MODBUS_OK;
+}
+
+
+static uint8_t write_single_register(const uint8_t *request, uint8_t length, uint8_t *response)
+{
+	if(length != 6)
+		return MODBUS_ILLEGAL_VALUE;
+	uint8_t status = modbus_write_register(get16(request + 2), get16(request + 4));
+	if(status != MODBUS_OK)
+		return status;
+
+	//the response echoes the request
+	for(uint8_t i = 2; i < 6; ++i)
+		response[i] = request[i];
+	return MODBUS_OK;
+}
+
+
+static uint8_t write_multiple_registers(const uint8_t *request, uint8_t length, uint8_t *response)
+{
+	if(length < 7)
+		return MODBUS_ILLEGAL_VALUE;
+	uint16_t start = get16(request + 2);
+	uint16_t count = get16(request + 4);
+	if(count == 0 || count > MODBUS_MAX_REGISTERS || request[6] != count * 2 || length != 7 + count * 2)
+		return MODBUS_ILLEGAL_VALUE;
+
+	for(uint16_t i = 0; i < count; ++i)
+	{
+		uint8_t status = modbus_write_register(start + i, get16(request + 7 + i * 2));
+		if(status != MODBUS_OK)
+			return status;
+	}
+	for(uint8_t i = 2; i < 6; ++i)
+		response[i] = request[i];
+	return MODBUS_OK;
+}
+
+
+uint8_t modbus_process(const uint8_t *request, uint8_t length, uint8_t *response)
+{
+	/* This routine handles a complete RTU frame (address,
+	 * PDU and CRC) and builds the response frame into the
+	 * response buffer, which must hold MODBUS_MAX_FRAME bytes.
+	 * It returns the length of the response or 0 when nothing
+	 * should be sent back, i.e a corrupted frame, a frame for
+	 * another slave or a broadcast. The work done is bounded
+	 * by MODBUS_MAX_REGISTERS so it always fits in a control
+	 * tick.
+	 */
+	if(length < 4 || crc16(request, length) != 0)
+		return 0;	//a CRC over a frame including its own CRC is always 0
+	uint8_t address = request[0];
+	if(address != slave_address && address != MODBUS_BROADCAST)
+		return 0;
+	length -= 2;	//drop the CRC
+
+	uint8_t status;
+	uint8_t response_length = 0;
+	switch(request[1])
+	{
+		case MODBUS_READ_HOLDING_REGISTERS:
+		case MODBUS_READ_INPUT_REGISTERS: {
+			status = read_registers(request, length, response);
+			response_length = 3 + response[2];
+			break;
+		}
+		case MODBUS_WRITE_SINGLE_REGISTER: {
+			status = write_single_register(request, length, response);
+			response_length = 6;
+			break;
+		}
+		case MODBUS_WRITE_MULTIPLE_REGISTERS: {
+			status = write_multiple_registers(request, length, response);
+			response_length = 6;
+			break;
+		}
+		default: {
+			status = MODBUS_ILLEGAL_FUNCTION;
+			break;
+		}
+	}
+
+	if(address == MODBUS_BROADCAST)
+		return 0;	//broadcasts are never answered
+
+	response[0] = address;
+	response[1] = request[1];
+	if(status != MODBUS_OK)
+	{
+		response[1] |= 0x80;
+		response[2] = status;
+		response_length = 3;
+	}
+
+	uint16_t crc = crc16(response, response_length);
+	response[response_length++] = crc;	//the CRC is the only field sent low byte first
+	response[response_length++] = crc >> 8;
+	return response_length;
+}
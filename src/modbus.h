@@ -0,0 +1,66 @@
+/*
+ * modbus.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef MODBUS_H_
+#define MODBUS_H_
+
+#include <stdint.h>
+
+#define MODBUS_BROADCAST 0x00
+#define MODBUS_MAX_FRAME 64	//largest RTU frame accepted by the slave (unit = bytes)
+#define MODBUS_MAX_REGISTERS 16	//most registers read or written by a single request
+
+//supported function codes
+#define MODBUS_READ_HOLDING_REGISTERS 0x03
+#define MODBUS_READ_INPUT_REGISTERS 0x04
+#define MODBUS_WRITE_SINGLE_REGISTER 0x06
+#define MODBUS_WRITE_MULTIPLE_REGISTERS 0x10
+
+//exception codes, also returned by the register access routines below
+#define MODBUS_OK 0x00
+#define MODBUS_ILLEGAL_FUNCTION 0x01
+#define MODBUS_ILLEGAL_ADDRESS 0x02
+#define MODBUS_ILLEGAL_VALUE 0x03
+
+/* Register map. Holding and input registers share the same map,
+ * only the registers marked RW can be written.
+ */
+#define MODBUS_REG_SOC 0	//SOC of the battery (unit = %)
+#define MODBUS_REG_MILLIVOLTS 1	//battery voltage (unit = mV)
+#define MODBUS_REG_STATUS 2	//status flags, same bits as the telemetry snapshot flags
+#define MODBUS_REG_SOC_LIMIT 3	//RW SOC limit (unit = %)
+#define MODBUS_REG_COUNTDOWN 4	//count down time remaining (unit = minutes)
+#define MODBUS_REG_MIN_MILLIVOLTS 5	//lowest battery voltage seen (unit = mV)
+#define MODBUS_REG_MAX_MILLIVOLTS 6	//highest battery voltage seen (unit = mV)
+#define MODBUS_REG_MEAN_MILLIVOLTS 7	//mean battery voltage (unit = mV)
+#define MODBUS_REG_CUTOFFS 8	//number of low battery load cutoffs
+#define MODBUS_REG_CHARGE_CYCLES 9	//number of charge cycles
+#define MODBUS_REG_ENERGY_HIGH 10	//energy delivered to the load, high word (unit = mWh)
+#define MODBUS_REG_ENERGY_LOW 11	//energy delivered to the load, low word (unit = mWh)
+#define MODBUS_REG_LOW_TIME_HIGH 12	//time spent below the SOC limit, high word (unit = s)
+#define MODBUS_REG_LOW_TIME_LOW 13	//time spent below the SOC limit, low word (unit = s)
+#define MODBUS_REG_ADDRESS 14	//RW slave address of the module (1 - 247)
+#define MODBUS_REG_BOOT_TIME 15	//time from power up to the first protection decision (unit = us)
+#define MODBUS_REG_LOAD_OUTPUTS 16	//outputs of the load channels, one bit per channel in priority order
+#define MODBUS_REGISTER_COUNT 17
+
+void modbus_init(uint8_t address);
+void modbus_set_address(uint8_t address);
+uint8_t modbus_address(void);
+uint8_t modbus_process(const uint8_t *request, uint8_t length, uint8_t *response);
+
+/* Register access, implemented by the application. Both return
+ * MODBUS_OK or the exception code to be sent back to the master.
+ */
+uint8_t modbus_read_register(uint16_t address, uint16_t *value);
+uint8_t modbus_write_register(uint16_t address, uint16_t value);
+
+//RTU transport over the USART (AVR only)
+void modbus_rtu_init(void);
+void modbus_poll(void);
+
+#endif /* MODBUS_H_ */
@@ -0,0 +1,97 @@
+/*
+ * modbus_rtu.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "defs.h"
+#include "modbus.h"
+#include "uart.h"
+#include "snapshot.h"
+
+/* TIMER2 is used to detect the end of a frame: a silence of 3.5
+ * character times on the bus. With a prescaling of 256 the timer
+ * runs at 12MHz / 256 = 46875Hz. Above 19200 baud the Modbus spec
+ * fixes the silence at 1750us.
+ */
+#define TIMER2_FREQUENCY (F_CPU / 256)
+#if MODBUS_BAUD_RATE > 19200
+#define MODBUS_T35_TICKS ((TIMER2_FREQUENCY * 1750UL) / 1000000UL + 1)
+#else
+#define MODBUS_T35_TICKS ((TIMER2_FREQUENCY * 77UL) / (2UL * MODBUS_BAUD_RATE) + 1)	//3.5 * 11 bits
+#endif
+
+#if MODBUS_T35_TICKS > 256
+#error "MODBUS_BAUD_RATE is too low for the TIMER2 prescaler"
+#endif
+
+/* The frame buffer belongs to the receive ISRs while rx_ready is
+ * clear and to modbus_poll while it is set, the flag hands it over.
+ */
+static uint8_t rx_frame[MODBUS_MAX_FRAME];
+static uint8_t rx_length = 0;
+static uint8_t rx_error = FALSE;	//the frame being received is corrupted and has to be dropped
+static uint8_t rx_ready = FALSE;	//a complete frame is waiting for modbus_poll
+
+
+static void modbus_receive(uint8_t byte, uint8_t error)
+{
+	/* USART receive handler. Every received byte restarts
+	 * the 3.5 character timer. Bytes arriving while the
+	 * previous frame is still being handled are dropped.
+	 */
+	if(shared_load8(&rx_ready))
+		return;
+
+	if(error || rx_length == MODBUS_MAX_FRAME)
+		rx_error = TRUE;
+	else
+		rx_frame[rx_length++] = byte;
+
+	TCNT2 = 0;
+	TCCR2 = (1 << WGM21) | (1 << CS22) | (1 << CS21);	//CTC mode, prescaling of 256
+	return;
+}
+
+
+void modbus_rtu_init(void)
+{
+	OCR2 = MODBUS_T35_TICKS - 1;
+	TIMSK |= (1 << OCIE2);
+	RS485_RECEIVE;
+	uart_set_rx_handler(modbus_receive);
+	return;
+}
+
+
+void modbus_poll(void)
+{
+	/* Handles a complete frame if one has been received.
+	 * Called from the background tasks of the main loop.
+	 */
+	if(!shared_load8(&rx_ready))
+		return;
+
+	static uint8_t response[MODBUS_MAX_FRAME];
+	uint8_t length = 0;
+	if(!rx_error)
+		length = modbus_process(rx_frame, rx_length, response);
+	if(length)
+		uart_write(response, length);
+
+	rx_length = 0;
+	rx_error = FALSE;
+	shared_store8(&rx_ready, FALSE);
+	return;
+}
+
+
+ISR(TIMER2_COMP_vect)
+{
+	//3.5 character times of silence, the frame is complete
+	TCCR2 = 0;
+	if(rx_length || rx_error)
+		shared_store8(&rx_ready, TRUE);
+}
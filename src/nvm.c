@@ -0,0 +1,93 @@
+/*
+ * nvm.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include "defs.h"
+#include "nvm.h"
+#include "spsc.h"
+#include "snapshot.h"
+
+/* Asynchronous EEPROM writer. A byte write takes about 3.4ms so
+ * block writes are queued and written one byte at a time from the
+ * EEPROM Ready ISR, the main loop never waits for the EEPROM. The
+ * data of a queued write is not copied, the caller must leave it
+ * untouched until nvm_busy() returns FALSE.
+ */
+struct nvm_job
+{
+	uint16_t address;
+	const uint8_t *data;
+	uint8_t length;
+};
+
+SPSC_QUEUE(nvm_queue, struct nvm_job, NVM_QUEUE_SIZE)
+static struct nvm_queue queue;
+static struct nvm_job current;	//the job being written, only used by the ISR
+static uint8_t writing = FALSE;	//set by nvm_write, cleared by the ISR once the queue is empty
+
+
+uint8_t nvm_write(uint16_t address, const void *data, uint8_t length)
+{
+	/* Queues a block write, FALSE is returned when the queue
+	 * is full and the write has to be retried later.
+	 */
+	struct nvm_job job = { address, data, length };
+	if(!nvm_queue_push(&queue, &job))
+		return FALSE;
+
+	//set after the push: the ISR enabled below clears it only once it has found the queue empty
+	shared_store8(&writing, TRUE);
+	EECR |= (1 << EERIE);	//fires right away if no write is in progress
+	return TRUE;
+}
+
+
+uint8_t nvm_busy(void)
+{
+	return shared_load8(&writing);
+}
+
+
+uint8_t nvm_read(uint16_t address, void *data, uint8_t length)
+{
+	/* Reads share EEAR with the ISR so they are only allowed
+	 * while no write is queued, FALSE is returned otherwise.
+	 */
+	if(shared_load8(&writing))
+		return FALSE;
+	eeprom_read_block(data, (const void*)address, length);
+	return TRUE;
+}
+
+
+ISR(EE_RDY_vect)
+{
+	while(current.length || nvm_queue_pop(&queue, &current))
+	{
+		while(current.length)
+		{
+			uint16_t address = current.address++;
+			uint8_t byte = *current.data++;
+			--current.length;
+
+			//skip bytes that already hold the value, saves both time and wear
+			EEAR = address;
+			EECR |= (1 << EERE);
+			if(EEDR == byte)
+				continue;
+
+			EEDR = byte;
+			EECR |= (1 << EEMWE);
+			EECR |= (1 << EEWE);
+			return;	//the ISR fires again once this byte has been written
+		}
+	}
+
+	EECR &= ~(1 << EERIE);
+	shared_store8(&writing, FALSE);
+}
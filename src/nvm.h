@@ -0,0 +1,30 @@
+/*
+ * nvm.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef NVM_H_
+#define NVM_H_
+
+#include <stdint.h>
+
+/* EEPROM layout (1024 bytes on the ATmega32). The first bytes are
+ * left unused since they are the most likely to be corrupted by a
+ * brown-out during a write on older parts.
+ */
+#define NVM_SETTINGS_BASE 0x010
+#define NVM_SETTINGS_SIZE 0x0F0
+#define NVM_EVLOG_BASE 0x100
+#define NVM_EVLOG_SIZE 0x2E0
+#define NVM_CALIBRATION_BASE 0x3E0
+#define NVM_CALIBRATION_SIZE 0x020
+
+#define NVM_QUEUE_SIZE 4	//number of block writes that can be queued at once, a power of two
+
+uint8_t nvm_write(uint16_t address, const void *data, uint8_t length);
+uint8_t nvm_busy(void);
+uint8_t nvm_read(uint16_t address, void *data, uint8_t length);
+
+#endif /* NVM_H_ */
@@ -0,0 +1,28 @@
+/*
+ * pgm.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef PGM_H_
+#define PGM_H_
+
+/* Constant tables are kept in flash on the AVR so they don't
+ * take up SRAM. On the host the same sources are built with
+ * plain const data so they can be shared with the host tools.
+ */
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#include <stdint.h>
+#include <string.h>
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_ptr(p) (*(const void * const *)(p))
+#define strlen_P(s) strlen(s)
+#endif
+
+#endif /* PGM_H_ */
@@ -0,0 +1,108 @@
+/*
+ * prof.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include "prof.h"
+
+#ifdef PROFILING
+
+#include <string.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "snapshot.h"
+
+extern struct snapshot32 gMillis;	//system tick kept by the TIMER1 ISR in main.c
+
+static struct prof_probe prof_probes[PROF_PROBES];
+static uint16_t prof_overhead;	//ticks spent by an empty PROF_ENTER/PROF_EXIT pair
+
+
+uint32_t prof_now(void)
+{
+	/* Returns a free-running time stamp in TIMER1 ticks made of
+	 * the system tick and TCNT1. A compare match that is still
+	 * pending has already wrapped TCNT1 but not yet incremented
+	 * the system tick, it is accounted for here. Inside the
+	 * TIMER1 ISR the system tick must have been incremented
+	 * already.
+	 */
+	uint32_t ms;
+	uint16_t ticks;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ticks = TCNT1;
+		ms = gMillis.value;
+		if((TIFR & (1 << OCF1A)) && ticks < PROF_TICKS_PER_MS / 2)
+			++ms;
+	}
+	return ms * PROF_TICKS_PER_MS + ticks;
+}
+
+
+void prof_init(void)
+{
+	//TIMER1 must be running already
+	prof_reset();
+	uint32_t start = prof_now();
+	prof_overhead = prof_now() - start;
+	return;
+}
+
+
+void prof_record(uint8_t probe, uint32_t start)
+{
+	/* Called from both the main loop and the TIMER1 ISR, every
+	 * probe is only ever updated from one of them so a probe
+	 * doesn't need any locking.
+	 */
+	uint32_t ticks = prof_now() - start;
+	ticks = (ticks > prof_overhead) ? ticks - prof_overhead : 0;
+
+	struct prof_probe *p = &prof_probes[probe];
+	if(ticks < p->min)
+		p->min = ticks;
+	if(ticks > p->max)
+		p->max = ticks;
+	if(p->count != 0xFFFF && p->sum + ticks >= p->sum)
+	{
+		p->sum += ticks;
+		++p->count;
+	}
+
+	uint8_t bucket = 0;
+	while(ticks && bucket < PROF_BUCKETS - 1)
+	{
+		ticks >>= 1;
+		++bucket;
+	}
+	if(p->histogram[bucket] != 0xFFFF)
+		++p->histogram[bucket];
+	return;
+}
+
+
+void prof_get(uint8_t probe, struct prof_probe *copy)
+{
+	//the TIMER1 ISR probe may be updated while it is copied
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		*copy = prof_probes[probe];
+	}
+	return;
+}
+
+
+void prof_reset(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		memset(prof_probes, 0, sizeof(prof_probes));
+		for(uint8_t i = 0; i < PROF_PROBES; ++i)
+			prof_probes[i].min = UINT32_MAX;
+	}
+	return;
+}
+
+#endif /* PROFILING */
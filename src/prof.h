@@ -0,0 +1,59 @@
+/*
+ * prof.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef PROF_H_
+#define PROF_H_
+
+#include <stdint.h>
+#include "defs.h"
+
+/* Cycle count profiling. A section of code is bracketed by
+ * PROF_ENTER(probe) and PROF_EXIT(probe), every pass through it
+ * updates the min/max/sum/count and a log2 histogram of that
+ * probe. The time stamps are taken from TIMER1, which runs at
+ * F_CPU/8, so the resolution is 8 CPU cycles. Without PROFILING
+ * defined in defs.h the probes compile to nothing.
+ */
+#define PROF_BATTERY_MANAGER 0
+#define PROF_LED_DISPLAY 1
+#define PROF_KEYPAD 2
+#define PROF_TIMER1_ISR 3
+#define PROF_BACKGROUND 4
+#define PROF_PROBES 5
+
+#define PROF_BUCKETS 16	//bucket n counts durations of 2^(n-1) up to 2^n - 1 ticks, the last one everything longer
+#define PROF_TICKS_PER_MS 1500	//TIMER1 ticks in a system tick
+#define PROF_CYCLES_PER_TICK 8	//CPU cycles in a TIMER1 tick
+
+struct prof_probe
+{
+	uint32_t min;	//unit = TIMER1 ticks
+	uint32_t max;
+	uint32_t sum;	//sum and count stop together when either would overflow, the mean stays valid
+	uint16_t count;
+	uint16_t histogram[PROF_BUCKETS];	//saturating counts
+};
+
+#ifdef PROFILING
+
+#define PROF_ENTER(probe) uint32_t prof_start_##probe = prof_now()
+#define PROF_EXIT(probe) prof_record(probe, prof_start_##probe)
+
+void prof_init(void);
+uint32_t prof_now(void);
+void prof_record(uint8_t probe, uint32_t start);
+void prof_get(uint8_t probe, struct prof_probe *copy);
+void prof_reset(void);
+
+#else
+
+#define PROF_ENTER(probe)
+#define PROF_EXIT(probe)
+
+#endif /* PROFILING */
+
+#endif /* PROF_H_ */
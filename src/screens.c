@@ -0,0 +1,197 @@
+/*
+ * screens.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include <string.h>
+#include "lcd.h"
+#include "graph.h"
+#include "stats.h"
+#include "control.h"
+#include "messages.h"
+#include "pgm.h"
+#include "screens.h"
+
+uint8_t gDashboard_Shown = 0;
+
+
+static void screen_dashboard_cursor(uint8_t line)
+{
+	//lines 2 and 3 of the dashboard go below lines 0 and 1 on a 4 row display, right of them on a 40 column one
+	if(lcd_rows() >= 4)
+		lcd_set_cursor(0, line);
+	else
+		lcd_set_cursor(DASHBOARD_LINE_WIDTH, line - 2);
+	return;
+}
+
+
+uint8_t screen_full_dashboard(void)
+{
+	//the display has room for the whole dashboard, no page rotation is needed
+	return lcd_rows() >= 4 || lcd_columns() >= 2 * DASHBOARD_LINE_WIDTH;
+}
+
+
+void screen_dashboard(const struct screen_status *status)
+{
+	/* Writes the SOC as a bar graph and as a number on the
+	 * first row of the LCD. The second row holds the battery
+	 * voltage, a sparkline of the latest voltage samples and
+	 * the SOC limit. A display with 4 rows or 40 columns also
+	 * gets the battery state, the load channels and the
+	 * statistics, which are otherwise shown on pages of their
+	 * own. Once drawn, only the characters and glyphs that
+	 * change are written.
+	 */
+	static uint8_t status_shown;
+	if(!gDashboard_Shown)
+	{
+		LCDClear();
+		graph_invalidate();
+		status_shown = 0xFF;
+		gDashboard_Shown = 1;
+	}
+	graph_bar(0, 0, DASHBOARD_BAR_CELLS, status->soc);
+	lcd_set_cursor(DASHBOARD_BAR_CELLS, 0);
+	lcd_printf_P(PSTR("%4u%%"), status->soc);
+	lcd_set_cursor(0, 1);
+	lcd_printf_P(PSTR("%4.1uV"), status->millivolts / 100);
+	graph_spark(5, 1, DASHBOARD_SPARK_SPAN);
+	lcd_printf_P(PSTR(" L%-2u"), status->soc_limit);
+	if(!screen_full_dashboard())
+		return;
+
+	//the state only changes with a control decision, it is left alone until then
+	uint8_t shown = status->state | status->outputs;	//the outputs are bits 5-7 of LOAD_PORT
+	if(shown != status_shown)
+	{
+		static const char* const states[] PROGMEM = { gMsg_Battery_Low, gMsg_Batt_Charging, gMsg_Load_On, gMsg_Load_Off };
+		char channels[LOAD_CHANNEL_COUNT + 1];
+		for(uint8_t i = 0; i < LOAD_CHANNEL_COUNT; ++i)
+			channels[i] = (status->outputs & gLoad_Channels[i].mask) ? '1' + i : '-';
+		channels[LOAD_CHANNEL_COUNT] = '\0';
+		screen_dashboard_cursor(2);
+		lcd_printf_P(PSTR("%-13S  CH%s"), (const char*)pgm_read_ptr(&states[status->state]), channels);
+		status_shown = shown;
+	}
+
+	const struct battery_stats* stats = stats_get();
+	screen_dashboard_cursor(3);
+	lcd_printf_P(PSTR("%4.1u %4.1u %4.1uV C%-3u"), (stats->samples ? stats->min_millivolts : 0) / 100,
+			stats_mean_millivolts() / 100, stats->max_millivolts / 100, stats->cutoffs);
+	return;
+}
+
+
+void screen_low_page(uint8_t soc)
+{
+	LCDClear();
+	LCDWriteStringXY_P(2, 0, gMsg_Battery_Low);
+	lcd_set_cursor(4, 1);
+	lcd_printf_P(PSTR("%u%%"), soc);
+	gDashboard_Shown = 0;
+	return;
+}
+
+
+void screen_charging_page(uint8_t soc)
+{
+	LCDClear();
+	LCDWriteStringXY_P(0, 0, gMsg_Batt_Charging);
+	LCDWriteStringXY_P(2, 1, gMsg_Soc);
+	lcd_set_cursor(8, 1);
+	lcd_printf_P(PSTR("%u%%"), soc);
+	gDashboard_Shown = 0;
+	return;
+}
+
+
+void screen_stats_page(void)
+{
+	/* Writes the running battery statistics. The first row
+	 * holds the minimum, mean and maximum battery voltage while
+	 * the second row holds the number of load cutoffs, the
+	 * number of charge cycles and the energy delivered to the
+	 * load.
+	 */
+	const struct battery_stats* stats = stats_get();
+	uint16_t mean = stats_mean_millivolts();
+	uint16_t min = stats->samples ? stats->min_millivolts : 0;
+
+	LCDClear();
+	lcd_set_cursor(0, 0);
+	lcd_printf_P(PSTR("%4.1u %4.1u %4.1uV"), min / 100, mean / 100, stats->max_millivolts / 100);
+	lcd_set_cursor(0, 1);
+	lcd_printf_P(PSTR("C%-3u G%-3u%4luWh"), stats->cutoffs, stats->charge_cycles,
+			(unsigned long)(stats->milli_watt_hours / 1000));
+	gDashboard_Shown = 0;
+	return;
+}
+
+
+void screen_prompt(const char *first, const char *second)
+{
+	//a menu or prompt of one or two rows from flash, second may be NULL
+	LCDClear();
+	LCDWriteStringXY_P(0, 0, first);
+	if(second)
+		LCDWriteStringXY_P(0, 1, second);
+	gDashboard_Shown = 0;
+	return;
+}
+
+
+void screen_key(char key)
+{
+	//echo the option picked from the menu
+	lcd_set_cursor(7, 1);
+	LCDData(key);
+	return;
+}
+
+
+void screen_input(uint8_t col, uint8_t row, char *input, const char *unit)
+{
+	//echo the digits typed so far followed by their unit from flash, the unit also clears the rest of the row
+	LCDWriteStringXY_P(0, row, gMsg_Blank_Row);
+	LCDWriteStringXY(col, row, input);
+	LCDWriteStringXY_P(col + strlen(input), row, unit);
+	return;
+}
+
+
+void screen_countdown(uint16_t minutes, uint8_t seconds)
+{
+	//the time left of a count down as hh:mm:ss
+	LCDClear();
+	LCDWriteIntXY(4, 0, minutes / 60, 2);
+	LCDData(':');
+	LCDWriteInt(minutes % 60, 2);
+	LCDData(':');
+	LCDWriteInt(seconds, 2);
+	LCDWriteStringXY_P(4, 1, gMsg_Countdown_Units);
+	gDashboard_Shown = 0;
+	return;
+}
+
+
+void screen_countdown_tick(uint16_t minutes, uint8_t seconds)
+{
+	//the hours and minutes only change when the seconds start over at 59
+	if(seconds == 59)
+	{
+		LCDWriteIntXY(4, 0, minutes / 60, 2);
+		LCDWriteIntXY(7, 0, minutes % 60, 2);
+	}
+	LCDWriteIntXY(10, 0, seconds, 2);
+	return;
+}
+
+
+void screen_countdown_expired(void)
+{
+	LCDWriteStringXY_P(0, 1, gMsg_Press_Stop);
+	return;
+}
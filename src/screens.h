@@ -0,0 +1,51 @@
+/*
+ * screens.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef SCREENS_H_
+#define SCREENS_H_
+
+#include <stdint.h>
+
+/* The screens of the LCD: the dashboard, the pages, the settings
+ * menu and the count down. They only draw what they are given, the
+ * firmware decides when to show them, so the host tools (budget,
+ * bench) measure the same code as the firmware runs.
+ */
+#define DASHBOARD_BAR_CELLS 11	//width of the SOC bar on the dashboard, 5 steps per cell
+#define DASHBOARD_SPARK_SPAN 200	//smallest voltage range filling the sparkline height (unit = mV)
+#define DASHBOARD_LINE_WIDTH 20	//a 40 column display shows dashboard lines 2 and 3 right of lines 0 and 1
+
+//state of the battery and the main load shown on a full dashboard
+#define SCREEN_STATE_LOW 0
+#define SCREEN_STATE_CHARGING 1
+#define SCREEN_STATE_LOAD_ON 2
+#define SCREEN_STATE_LOAD_OFF 3
+
+struct screen_status
+{
+	uint8_t soc;	//unit = %
+	uint16_t millivolts;
+	uint8_t soc_limit;	//unit = %
+	uint8_t state;	//SCREEN_STATE_ code
+	uint8_t outputs;	//outputs of the load channels, bits of LOAD_PORT
+};
+
+extern uint8_t gDashboard_Shown;	//cleared by every other screen so the next dashboard is drawn in full
+
+void screen_dashboard(const struct screen_status *status);
+uint8_t screen_full_dashboard(void);
+void screen_low_page(uint8_t soc);
+void screen_charging_page(uint8_t soc);
+void screen_stats_page(void);
+void screen_prompt(const char *first, const char *second);
+void screen_key(char key);
+void screen_input(uint8_t col, uint8_t row, char *input, const char *unit);
+void screen_countdown(uint16_t minutes, uint8_t seconds);
+void screen_countdown_tick(uint16_t minutes, uint8_t seconds);
+void screen_countdown_expired(void);
+
+#endif /* SCREENS_H_ */
@@ -0,0 +1,94 @@
+/*
+ * snapshot.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <stdint.h>
+
+/* Access to values shared between an ISR and the main loop without
+ * disabling interrupts.
+ *
+ * A byte is read and written in a single instruction, shared_load8
+ * and shared_store8 only add the ordering: whatever was written
+ * before a shared_store8 is seen by the side that reads the byte
+ * with shared_load8. This is how the main loop hands data over to
+ * an ISR: write it while the ISR leaves it alone, then set the flag
+ * the ISR checks.
+ *
+ * Wider values take several instructions and a reader can be
+ * interrupted half way through. A snapshot pairs the value with a
+ * sequence number that is odd while the writer is busy, the reader
+ * retries until it got the same even number before and after the
+ * value. The writer must never be interrupted by the reader, i.e.
+ * the ISR writes and the main loop reads, or the main loop writes
+ * while the ISR doesn't look at the value. The writer reads its own
+ * value with .value directly.
+ *
+ * The same code is built on the host where the two sides are
+ * threads, the fences then order the memory accesses of the cores
+ * as well as those of the compiler.
+ */
+#ifdef __AVR__
+#define SNAPSHOT_FENCE() __atomic_signal_fence(__ATOMIC_SEQ_CST)	//the other side runs on the same core
+#else
+#define SNAPSHOT_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+
+static inline uint8_t shared_load8(const uint8_t *flag)
+{
+	return __atomic_load_n(flag, __ATOMIC_ACQUIRE);
+}
+
+
+static inline void shared_store8(uint8_t *flag, uint8_t value)
+{
+	__atomic_store_n(flag, value, __ATOMIC_RELEASE);
+	return;
+}
+
+
+#define SNAPSHOT_DEFINE(bits) \
+struct snapshot##bits \
+{ \
+	uint8_t sequence; \
+	uint##bits##_t value; \
+}; \
+\
+static inline void snapshot##bits##_write(struct snapshot##bits *snapshot, uint##bits##_t value) \
+{ \
+	uint8_t sequence = snapshot->sequence; \
+	__atomic_store_n(&snapshot->sequence, sequence + 1, __ATOMIC_RELAXED); \
+	SNAPSHOT_FENCE(); \
+	*(volatile uint##bits##_t *)&snapshot->value = value; \
+	SNAPSHOT_FENCE(); \
+	__atomic_store_n(&snapshot->sequence, sequence + 2, __ATOMIC_RELAXED); \
+	return; \
+} \
+\
+static inline uint##bits##_t snapshot##bits##_read(const struct snapshot##bits *snapshot) \
+{ \
+	uint8_t begin, end; \
+	uint##bits##_t value; \
+	do \
+	{ \
+		begin = __atomic_load_n(&snapshot->sequence, __ATOMIC_RELAXED); \
+		SNAPSHOT_FENCE(); \
+		value = *(const volatile uint##bits##_t *)&snapshot->value; \
+		SNAPSHOT_FENCE(); \
+		end = __atomic_load_n(&snapshot->sequence, __ATOMIC_RELAXED); \
+	} while((begin & 1) || begin != end); \
+	return value; \
+}
+
+SNAPSHOT_DEFINE(16)
+SNAPSHOT_DEFINE(32)
+
+#define SNAPSHOT_INIT(v) { 0, (v) }
+
+#endif /* SNAPSHOT_H_ */
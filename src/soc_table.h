@@ -0,0 +1,20 @@
+/*
+ * soc_table.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Open circuit voltage of the battery at every SOC_TABLE_STEP % of
+ * SOC, from 0% to 100%, used by control_soc (unit = mV). Written by
+ * tools/ocvfit from field logs, this default is the linear 0-12V scale
+ * of the ADC.
+ */
+
+#ifndef SOC_TABLE_H_
+#define SOC_TABLE_H_
+
+#define SOC_TABLE_STEP 10
+#define SOC_TABLE_POINTS 11
+#define SOC_TABLE_MILLIVOLTS { 0, 1200, 2400, 3600, 4800, 6000, 7200, 8400, 9600, 10800, 12000 }
+
+#endif /* SOC_TABLE_H_ */
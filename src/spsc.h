@@ -0,0 +1,64 @@
+/*
+ * spsc.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef SPSC_H_
+#define SPSC_H_
+
+#include <stdint.h>
+
+/* Single producer, single consumer ring queue, e.g. an ISR pushing
+ * and the main loop popping. Neither side disables interrupts: the
+ * head is only written by the producer and the tail only by the
+ * consumer, both are bytes so they are read and written in a single
+ * instruction. The indexes run freely and are masked on access, the
+ * size must be a power of two no larger than 128 so all of the
+ * entries can be used.
+ *
+ * SPSC_QUEUE(countdown_queue, struct countdown_tick, 4) defines
+ * struct countdown_queue along with countdown_queue_push(),
+ * countdown_queue_pop() and countdown_queue_count(). A queue starts
+ * out zeroed, as a global or with memset.
+ */
+#define SPSC_QUEUE(name, type, size) \
+struct name \
+{ \
+	type entries[size]; \
+	uint8_t head; \
+	uint8_t tail; \
+}; \
+\
+_Static_assert((size) > 0 && (size) <= 128 && ((size) & ((size) - 1)) == 0, \
+		#name " size must be a power of two no larger than 128"); \
+\
+static inline uint8_t name##_push(struct name *queue, const type *entry) \
+{ \
+	/* returns 0 and leaves the entry out when the queue is full */ \
+	uint8_t head = queue->head; \
+	if((uint8_t)(head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE)) == (size)) \
+		return 0; \
+	queue->entries[head & ((size) - 1)] = *entry; \
+	__atomic_store_n(&queue->head, (uint8_t)(head + 1), __ATOMIC_RELEASE); \
+	return 1; \
+} \
+\
+static inline uint8_t name##_pop(struct name *queue, type *entry) \
+{ \
+	/* returns 0 when the queue is empty */ \
+	uint8_t tail = queue->tail; \
+	if(tail == __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE)) \
+		return 0; \
+	*entry = queue->entries[tail & ((size) - 1)]; \
+	__atomic_store_n(&queue->tail, (uint8_t)(tail + 1), __ATOMIC_RELEASE); \
+	return 1; \
+} \
+\
+static inline uint8_t name##_count(struct name *queue) \
+{ \
+	return __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE); \
+}
+
+#endif /* SPSC_H_ */
@@ -0,0 +1,144 @@
+/*
+ * stats.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include "stats.h"
+
+#define MILLI_SECONDS_PER_SECOND 1000UL
+#define MILLI_SECONDS_PER_HOUR 3600000UL
+#define MAX_SAMPLE_INTERVAL 60000UL	//longest gap between two samples that is accounted for (unit = ms)
+
+static struct battery_stats battery_stats;	//the instance kept by the firmware
+
+
+void stats_reset(struct battery_stats *stats, uint32_t now)
+{
+	stats->min_millivolts = 0xFFFF;
+	stats->max_millivolts = 0;
+	stats->sum_millivolts = 0;
+	stats->samples = 0;
+	stats->low_seconds = 0;
+	stats->cutoffs = 0;
+	stats->charge_cycles = 0;
+	stats->milli_amp_hours = 0;
+	stats->milli_watt_hours = 0;
+	stats->low_residue = 0;
+	stats->charge_residue = 0;
+	stats->energy_residue = 0;
+	stats->last_sample = now;
+	return;
+}
+
+
+void stats_add_sample(struct battery_stats *stats, uint16_t millivolts, uint16_t load_current, uint8_t below_limit,
+		uint32_t now)
+{
+	/* This routine folds a single battery sample into the
+	 * running aggregates. load_current is the estimated
+	 * current drawn by the load in mA (0 when the load is
+	 * disconnected) and below_limit indicates that the SOC
+	 * is currently below the SOC limit.
+	 */
+	uint32_t interval = now - stats->last_sample;
+	stats->last_sample = now;
+	if(interval > MAX_SAMPLE_INTERVAL)
+		interval = MAX_SAMPLE_INTERVAL;
+
+	if(millivolts < stats->min_millivolts)
+		stats->min_millivolts = millivolts;
+	if(millivolts > stats->max_millivolts)
+		stats->max_millivolts = millivolts;
+
+	/* halve both the sum and the sample count before the count
+	 * overflows. This keeps the mean intact while older samples
+	 * slowly lose their weight.
+	 */
+	if(stats->samples == 0xFFFF)
+	{
+		stats->sum_millivolts >>= 1;
+		stats->samples >>= 1;
+	}
+	stats->sum_millivolts += millivolts;
+	++stats->samples;
+
+	if(below_limit)
+	{
+		stats->low_residue += interval;
+		if(stats->low_residue >= MILLI_SECONDS_PER_SECOND)
+		{
+			stats->low_seconds += stats->low_residue / MILLI_SECONDS_PER_SECOND;
+			stats->low_residue %= MILLI_SECONDS_PER_SECOND;
+		}
+	}
+
+	if(load_current)
+	{
+		//charge in mA.ms, carried into mAh once a whole mAh has been accumulated
+		stats->charge_residue += (uint32_t)load_current * interval;
+		if(stats->charge_residue >= MILLI_SECONDS_PER_HOUR)
+		{
+			stats->milli_amp_hours += stats->charge_residue / MILLI_SECONDS_PER_HOUR;
+			stats->charge_residue %= MILLI_SECONDS_PER_HOUR;
+		}
+
+		//energy in mW.ms, carried into mWh the same way
+		uint32_t milli_watts = ((uint32_t)millivolts * load_current) / 1000;
+		stats->energy_residue += milli_watts * interval;
+		if(stats->energy_residue >= MILLI_SECONDS_PER_HOUR)
+		{
+			stats->milli_watt_hours += stats->energy_residue / MILLI_SECONDS_PER_HOUR;
+			stats->energy_residue %= MILLI_SECONDS_PER_HOUR;
+		}
+	}
+	return;
+}
+
+
+uint16_t stats_mean(const struct battery_stats *stats)
+{
+	if(!stats->samples)
+		return 0;
+	return stats->sum_millivolts / stats->samples;
+}
+
+
+void stats_init(uint32_t now)
+{
+	stats_reset(&battery_stats, now);
+	return;
+}
+
+
+void stats_sample(uint16_t millivolts, uint16_t load_current, uint8_t below_limit, uint32_t now)
+{
+	stats_add_sample(&battery_stats, millivolts, load_current, below_limit, now);
+	return;
+}
+
+
+void stats_cutoff(void)
+{
+	++battery_stats.cutoffs;
+	return;
+}
+
+
+void stats_charge_start(void)
+{
+	++battery_stats.charge_cycles;
+	return;
+}
+
+
+uint16_t stats_mean_millivolts(void)
+{
+	return stats_mean(&battery_stats);
+}
+
+
+const struct battery_stats* stats_get(void)
+{
+	return &battery_stats;
+}
@@ -0,0 +1,53 @@
+/*
+ * stats.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdint.h>
+
+/* Running battery statistics. Every field is updated in O(1)
+ * per sample with integer arithmetic only, so the aggregates
+ * can be kept for the whole uptime of the module without
+ * adding any cost to the control path.
+ */
+struct battery_stats
+{
+	uint16_t min_millivolts;	//lowest battery voltage seen (unit = mV)
+	uint16_t max_millivolts;	//highest battery voltage seen (unit = mV)
+	uint32_t sum_millivolts;	//sum of the samples used for the running mean
+	uint16_t samples;	//number of samples held in sum_millivolts
+
+	uint32_t low_seconds;	//time spent with the SOC below the SOC limit (unit = s)
+	uint16_t cutoffs;	//number of times the load was disconnected because of a low battery
+	uint16_t charge_cycles;	//number of times battery charging was started
+
+	uint32_t milli_amp_hours;	//charge delivered to the load (unit = mAh)
+	uint32_t milli_watt_hours;	//energy delivered to the load (unit = mWh)
+
+	//remainders carried between samples so that no charge or energy is lost to rounding
+	uint32_t low_residue;	//unit = ms
+	uint32_t charge_residue;	//unit = mA.ms
+	uint32_t energy_residue;	//unit = mW.ms
+	uint32_t last_sample;	//time stamp of the previous sample (unit = ms)
+};
+
+//re-entrant core, used by the host tools to keep any number of instances
+void stats_reset(struct battery_stats *stats, uint32_t now);
+void stats_add_sample(struct battery_stats *stats, uint16_t millivolts, uint16_t load_current, uint8_t below_limit,
+		uint32_t now);
+uint16_t stats_mean(const struct battery_stats *stats);
+
+//the instance kept by the firmware
+void stats_init(uint32_t now);
+void stats_sample(uint16_t millivolts, uint16_t load_current, uint8_t below_limit, uint32_t now);
+void stats_cutoff(void);
+void stats_charge_start(void);
+uint16_t stats_mean_millivolts(void);
+const struct battery_stats* stats_get(void);
+
+#endif /* STATS_H_ */
@@ -0,0 +1,231 @@
+/*
+ * telemetry.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include "telemetry.h"
+#include "stats.h"
+#include "evlog.h"
+#include "uart.h"
+#include "prof.h"
+#include "memwatch.h"
+
+static uint16_t telemetry_period;	//time between two snapshot frames (unit = ms), 0 disables snapshots
+static uint32_t telemetry_next;	//time stamp of the next snapshot frame (unit = ms)
+static uint8_t snapshot_count;
+static uint8_t telemetry_enabled = 0;	//the USART is shared with the Modbus slave, nothing is sent unless initialized
+static volatile uint8_t dump_requested = 0;	//set by the receive ISR when a dump command arrives
+static uint8_t dumping = 0;
+static uint16_t dump_count;	//records sent by the dump in progress
+#ifdef PROFILING
+static volatile uint8_t profile_requested = 0;	//set by the receive ISR, FRAME_COMMAND_PROFILE or FRAME_COMMAND_PROFILE_RESET
+static uint8_t profile_next = PROF_PROBES;	//next probe to be sent, PROF_PROBES when none
+#endif
+
+
+static void telemetry_send(uint8_t type, const uint8_t *payload, uint8_t length)
+{
+	/* Frames that don't fit into the transmit buffer are
+	 * dropped instead of waiting for the USART, this keeps
+	 * the telemetry stream from adding latency to the control
+	 * loop.
+	 */
+	if(!telemetry_enabled)
+		return;
+	uint8_t frame[FRAME_MAX_PAYLOAD + FRAME_OVERHEAD];
+	uint8_t frame_length = frame_encode(type, payload, length, frame);
+	uart_write(frame, frame_length);
+	return;
+}
+
+
+static void telemetry_receive(uint8_t byte, uint8_t error)
+{
+	if(error)
+		return;
+	if(byte == FRAME_COMMAND_DUMP)
+		dump_requested = 1;
+#ifdef PROFILING
+	else if(byte == FRAME_COMMAND_PROFILE || byte == FRAME_COMMAND_PROFILE_RESET)
+		profile_requested = byte;
+#endif
+	return;
+}
+
+
+void telemetry_init(uint16_t period)
+{
+	telemetry_period = period;
+	telemetry_next = 0;
+	snapshot_count = 0;
+	telemetry_enabled = 1;
+	uart_set_rx_handler(telemetry_receive);
+	return;
+}
+
+
+void telemetry_set_period(uint16_t period)
+{
+	telemetry_period = period;
+	return;
+}
+
+
+uint8_t telemetry_due(uint32_t now)
+{
+	//returns TRUE when the next snapshot frame should be sent
+	if(!telemetry_enabled || !telemetry_period || (int32_t)(now - telemetry_next) < 0)
+		return 0;
+	telemetry_next = now + telemetry_period;
+	return 1;
+}
+
+
+void telemetry_send_snapshot(uint32_t now, uint16_t millivolts, uint8_t soc, uint8_t soc_limit,
+		uint8_t flags, uint16_t countdown)
+{
+	uint8_t payload[FRAME_SNAPSHOT_LENGTH];
+	uint8_t *p = frame_put32(payload, now);
+	p = frame_put16(p, millivolts);
+	*p++ = soc;
+	*p++ = soc_limit;
+	*p++ = flags;
+	frame_put16(p, countdown);
+	telemetry_send(FRAME_SNAPSHOT, payload, FRAME_SNAPSHOT_LENGTH);
+
+	if(++snapshot_count >= TELEMETRY_STATS_DIVIDER)
+	{
+		snapshot_count = 0;
+		telemetry_send_stats();
+		telemetry_send_memory();
+	}
+	return;
+}
+
+
+void telemetry_send_event(uint32_t now, uint8_t code, uint8_t soc)
+{
+	uint8_t payload[FRAME_EVENT_LENGTH];
+	uint8_t *p = frame_put32(payload, now);
+	*p++ = code;
+	*p = soc;
+	telemetry_send(FRAME_EVENT, payload, FRAME_EVENT_LENGTH);
+	return;
+}
+
+
+void telemetry_send_stats(void)
+{
+	const struct battery_stats* stats = stats_get();
+	uint8_t payload[FRAME_STATS_LENGTH];
+	uint8_t *p = frame_put16(payload, stats->samples ? stats->min_millivolts : 0);
+	p = frame_put16(p, stats->max_millivolts);
+	p = frame_put16(p, stats_mean_millivolts());
+	p = frame_put32(p, stats->low_seconds);
+	p = frame_put16(p, stats->cutoffs);
+	p = frame_put16(p, stats->charge_cycles);
+	p = frame_put32(p, stats->milli_amp_hours);
+	frame_put32(p, stats->milli_watt_hours);
+	telemetry_send(FRAME_STATS, payload, FRAME_STATS_LENGTH);
+	return;
+}
+
+
+void telemetry_send_memory(void)
+{
+	const struct memwatch* memory = memwatch_get();
+	uint8_t payload[FRAME_MEMORY_LENGTH];
+	uint8_t *p = frame_put16(payload, memory->static_size);
+	p = frame_put16(p, memory->heap_max);
+	p = frame_put16(p, memory->stack_max);
+	frame_put16(p, memory->free_min);
+	telemetry_send(FRAME_MEMORY, payload, FRAME_MEMORY_LENGTH);
+	return;
+}
+
+
+void telemetry_send_boot(uint16_t protect_time, uint8_t reset_cause)
+{
+	//protect_time is the time from power up to the first protection decision (unit = us)
+	uint8_t payload[FRAME_BOOT_LENGTH];
+	uint8_t *p = frame_put16(payload, protect_time);
+	*p = reset_cause;
+	telemetry_send(FRAME_BOOT, payload, FRAME_BOOT_LENGTH);
+	return;
+}
+
+
+void telemetry_poll(void)
+{
+	/* Streams an event log dump. As many records are sent as
+	 * fit into the transmit buffer on every call so the dump
+	 * never holds up the main loop. Called from the background
+	 * tasks.
+	 */
+	if(dump_requested && !dumping)
+	{
+		dump_requested = 0;
+		dumping = 1;
+		dump_count = 0;
+		evlog_dump_start();
+	}
+
+	while(dumping && uart_tx_free() >= EVLOG_PAGE_RECORDS * FRAME_EVLOG_RECORD_LENGTH + FRAME_OVERHEAD)
+	{
+		struct evlog_record records[EVLOG_PAGE_RECORDS];
+		uint8_t count = evlog_dump_next(records);
+		if(count == EVLOG_DUMP_WAIT)
+			break;
+
+		uint8_t payload[EVLOG_PAGE_RECORDS * FRAME_EVLOG_RECORD_LENGTH];
+		if(count == 0)
+		{
+			frame_put16(payload, dump_count);
+			telemetry_send(FRAME_EVLOG_END, payload, FRAME_EVLOG_END_LENGTH);
+			dumping = 0;
+			break;
+		}
+
+		uint8_t *p = payload;
+		for(uint8_t i = 0; i < count; ++i)
+		{
+			p = frame_put32(p, records[i].time);
+			*p++ = records[i].code;
+			*p++ = records[i].soc;
+			*p++ = records[i].state;
+			*p++ = records[i].sequence;
+		}
+		telemetry_send(FRAME_EVLOG, payload, count * FRAME_EVLOG_RECORD_LENGTH);
+		dump_count += count;
+	}
+
+#ifdef PROFILING
+	//the profiling probes are sent one frame per probe the same way
+	if(profile_requested == FRAME_COMMAND_PROFILE_RESET)
+		prof_reset();
+	else if(profile_requested == FRAME_COMMAND_PROFILE)
+		profile_next = 0;
+	profile_requested = 0;
+
+	while(profile_next < PROF_PROBES && uart_tx_free() >= FRAME_PROFILE_LENGTH + FRAME_OVERHEAD)
+	{
+		struct prof_probe probe;
+		prof_get(profile_next, &probe);
+
+		uint8_t payload[FRAME_PROFILE_LENGTH];
+		uint8_t *p = payload;
+		*p++ = profile_next;
+		*p++ = PROF_PROBES;
+		p = frame_put16(p, probe.count);
+		p = frame_put32(p, probe.count ? probe.min : 0);
+		p = frame_put32(p, probe.max);
+		p = frame_put32(p, probe.sum);
+		for(uint8_t i = 0; i < PROF_BUCKETS; ++i)
+			p = frame_put16(p, probe.histogram[i]);
+		telemetry_send(FRAME_PROFILE, payload, FRAME_PROFILE_LENGTH);
+		++profile_next;
+	}
+#endif
+	return;
+}
@@ -0,0 +1,27 @@
+/*
+ * telemetry.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+#include "frame.h"
+
+#define TELEMETRY_STATS_DIVIDER 10	//a statistics frame is sent after every 10 snapshot frames
+
+void telemetry_init(uint16_t period);
+void telemetry_set_period(uint16_t period);
+uint8_t telemetry_due(uint32_t now);
+void telemetry_send_snapshot(uint32_t now, uint16_t millivolts, uint8_t soc, uint8_t soc_limit,
+		uint8_t flags, uint16_t countdown);
+void telemetry_send_event(uint32_t now, uint8_t code, uint8_t soc);
+void telemetry_send_stats(void);
+void telemetry_send_memory(void);
+void telemetry_send_boot(uint16_t protect_time, uint8_t reset_cause);
+void telemetry_poll(void);
+
+#endif /* TELEMETRY_H_ */
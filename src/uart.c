@@ -0,0 +1,113 @@
+/*
+ * uart.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "defs.h"
+#include "uart.h"
+#include "spsc.h"
+
+/* The transmit queue is filled by the main loop and drained by the
+ * USART Data Register Empty ISR, neither side has to disable
+ * interrupts to update it.
+ */
+SPSC_QUEUE(uart_tx_queue, uint8_t, UART_TX_BUFFER_SIZE)
+static struct uart_tx_queue tx_queue;
+
+//called from the receive ISR with every received byte
+static void (*rx_handler)(uint8_t byte, uint8_t error) = NULL;
+
+
+void uart_init(uint32_t baud_rate)
+{
+	/* use double speed mode (U2X) which gives a much smaller
+	 * baud rate error with the 12MHz clock, e.g 0.2% at 38400
+	 */
+	uint16_t ubrr = ((F_CPU + baud_rate * 4) / (baud_rate * 8)) - 1;
+	UBRRH = ubrr >> 8;
+	UBRRL = ubrr;
+	UCSRA = (1 << U2X);
+
+	//8 data bits, no parity, 1 stop bit
+	UCSRC = (1 << URSEL) | (1 << UCSZ1) | (1 << UCSZ0);
+	UCSRB = (1 << TXEN);
+
+#ifdef MODBUS_SLAVE
+	//the transmit complete interrupt releases the RS-485 bus once the last byte is out
+	UCSRB |= (1 << TXCIE);
+#endif
+	return;
+}
+
+
+void uart_set_rx_handler(void (*handler)(uint8_t byte, uint8_t error))
+{
+	rx_handler = handler;
+	UCSRB |= (1 << RXEN) | (1 << RXCIE);
+	return;
+}
+
+
+uint8_t uart_tx_free(void)
+{
+	//number of bytes that can still be queued for transmission
+	return UART_TX_BUFFER_SIZE - uart_tx_queue_count(&tx_queue);
+}
+
+
+uint8_t uart_write(const uint8_t *data, uint8_t length)
+{
+	/* This routine queues data for transmission without
+	 * ever waiting for the USART. The data is queued as a
+	 * whole or not at all so frames are never cut in half,
+	 * FALSE is returned when there isn't enough room left.
+	 */
+	if(length > uart_tx_free())
+		return FALSE;
+
+	for(uint8_t i = 0; i < length; ++i)
+		uart_tx_queue_push(&tx_queue, &data[i]);
+
+#ifdef MODBUS_SLAVE
+	RS485_TRANSMIT;
+#endif
+
+	//the ISR disables itself once the buffer has been drained
+	UCSRB |= (1 << UDRIE);
+	return TRUE;
+}
+
+
+ISR(USART_UDRE_vect)
+{
+	uint8_t byte;
+	if(!uart_tx_queue_pop(&tx_queue, &byte))
+	{
+		UCSRB &= ~(1 << UDRIE);
+		return;
+	}
+	UDR = byte;
+}
+
+
+ISR(USART_RXC_vect)
+{
+	//the status has to be read before UDR, reading UDR clears the error flags
+	uint8_t error = UCSRA & ((1 << FE) | (1 << DOR) | (1 << PE));
+	uint8_t byte = UDR;
+	if(rx_handler)
+		rx_handler(byte, error);
+}
+
+
+#ifdef MODBUS_SLAVE
+ISR(USART_TXC_vect)
+{
+	//all queued bytes have left the shift register, give the bus back
+	if(!uart_tx_queue_count(&tx_queue))
+		RS485_RECEIVE;
+}
+#endif
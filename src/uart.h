@@ -0,0 +1,20 @@
+/*
+ * uart.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef UART_H_
+#define UART_H_
+
+#include <stdint.h>
+
+#define UART_TX_BUFFER_SIZE 64	//must be a power of two no larger than 128, see spsc.h
+
+void uart_init(uint32_t baud_rate);
+uint8_t uart_tx_free(void);
+uint8_t uart_write(const uint8_t *data, uint8_t length);
+void uart_set_rx_handler(void (*handler)(uint8_t byte, uint8_t error));
+
+#endif /* UART_H_ */
@@ -0,0 +1,263 @@
+/*
+ * bench.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Micro-benchmarks for the formatting, parsing and LCD output routines
+ * and the LCD bus traffic of every screen update of the firmware.
+ *
+ * Build:
+ *   cc -O2 -Wall -DLCD_BUS_STATS -I tools/host -I src -o bench tools/bench.c src/lcd.c src/convert.c src/graph.c src/screens.c src/stats.c src/control.c src/messages.c
+ *
+ * Usage:
+ *   bench [-c] [iterations]
+ *
+ * Every routine reports the time and cycles per call on the host (the
+ * cycles come from the time stamp counter on x86 and are 0 elsewhere),
+ * the heap bytes it holds (as counted by the host allocator) and the
+ * LCD bus transfers it makes. The screen updates call the routines of
+ * screens.c, the firmware's own pages. The bus numbers don't depend on the host:
+ * the wait time is what the busy waits of the LCD driver cost on the
+ * target. -c prints CSV, the rows keep their order so two runs can be
+ * compared with diff.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES() __rdtsc()
+#else
+#define CYCLES() 0
+#endif
+#include "lcd.h"
+#include "convert.h"
+#include "graph.h"
+#include "pgm.h"
+#include "screens.h"
+#include "stats.h"
+
+static volatile uint32_t sink;	//keeps the results of the routines alive
+static int csv = 0;
+static long iterations = 200000;
+
+struct measurement
+{
+	double nanoseconds;	//per call
+	double cycles;
+	long heap;	//bytes held by a call until its result is freed
+	struct lcd_bus_stats bus;	//transfers of a single call
+};
+
+
+static double now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+
+static long heap_in_use(void)
+{
+#ifdef __GLIBC__
+	return mallinfo2().uordblks;
+#else
+	return 0;
+#endif
+}
+
+
+//the routines under test, each one a single call as the firmware makes it
+static void bench_write_int(void)
+{
+	LCDWriteInt(1234, 4);
+}
+
+
+static void bench_float_to_string(void)
+{
+	sink += float_to_string(87.5, '%')[0];
+	free(gString);
+}
+
+
+static void bench_string_to_integer(void)
+{
+	static char input[] = "1234";
+	sink += string_to_integer(input);
+}
+
+
+static void bench_printf(void)
+{
+	lcd_printf("%4.1u %4.1u %4.1uV", 114, 121, 128);
+}
+
+
+static void bench_printf_P(void)
+{
+	lcd_printf_P(PSTR("%4.1u %4.1u %4.1uV"), 114, 121, 128);
+}
+
+
+static void bench_puts(void)
+{
+	lcd_puts("BATT CHARGING");
+}
+
+
+static void bench_puts_P(void)
+{
+	lcd_puts_P(PSTR("BATT CHARGING"));
+}
+
+
+//the screen updates of battery_display and the count down
+static struct screen_status dashboard_status = { 87, 10440, 50, SCREEN_STATE_LOAD_ON, 1 << 5 };
+static uint16_t dashboard_sample = 0;
+
+static void page_battery_low(void)
+{
+	screen_low_page(42);
+}
+
+
+static void page_charging(void)
+{
+	screen_charging_page(87);
+}
+
+
+static void page_stats(void)
+{
+	screen_stats_page();
+}
+
+
+static void countdown_page(void)
+{
+	screen_countdown(90, 59);
+}
+
+
+static void countdown_tick(void)
+{
+	screen_countdown_tick(90, 42);
+}
+
+
+static void page_dashboard(void)
+{
+	//drawn in full after another page
+	gDashboard_Shown = 0;
+	screen_dashboard(&dashboard_status);
+}
+
+
+static void dashboard_update(void)
+{
+	//a slow discharge: the SOC moves by one pixel column of the bar every few samples
+	++dashboard_sample;
+	dashboard_status.millivolts = 10440 - dashboard_sample % 64;
+	dashboard_status.soc = dashboard_status.millivolts / 120;
+	graph_spark_add(dashboard_status.millivolts);
+	screen_dashboard(&dashboard_status);
+}
+
+
+static void measure(const char *name, void (*routine)(void))
+{
+	struct measurement m;
+
+	//a single call for the bytes and the bus transfers
+	long heap = heap_in_use();
+	memset(&lcd_bus_stats, 0, sizeof(lcd_bus_stats));
+	if(routine == bench_float_to_string)
+	{
+		//measured before the result is freed
+		float_to_string(87.5, '%');
+		m.heap = heap_in_use() - heap;
+		free(gString);
+	}
+	else
+	{
+		routine();
+		m.heap = heap_in_use() - heap;
+	}
+	m.bus = lcd_bus_stats;
+
+	for(long i = 0; i < iterations / 10; ++i)
+		routine();	//warm up
+	double start = now();
+	uint64_t cycles = CYCLES();
+	for(long i = 0; i < iterations; ++i)
+		routine();
+	cycles = CYCLES() - cycles;
+	m.nanoseconds = (now() - start) / iterations;
+	m.cycles = (double)cycles / iterations;
+
+	if(csv)
+		printf("%s,%.1f,%.0f,%ld,%u,%u,%u,%u\n", name, m.nanoseconds, m.cycles, m.heap, m.bus.commands,
+				m.bus.data, m.bus.nibbles, m.bus.wait_us);
+	else
+		printf("%-20s %9.1f %9.0f %6ld %8u %6u %8u %9u\n", name, m.nanoseconds, m.cycles, m.heap,
+				m.bus.commands, m.bus.data, m.bus.nibbles, m.bus.wait_us);
+}
+
+
+int main(int argc, char **argv)
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "-c"))
+			csv = 1;
+		else if(atol(argv[i]) > 0)
+			iterations = atol(argv[i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [-c] [iterations]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if(csv)
+		printf("name,ns_per_call,cycles_per_call,heap_bytes,lcd_commands,lcd_data,lcd_nibbles,lcd_wait_us\n");
+	else
+		printf("%-20s %9s %9s %6s %8s %6s %8s %9s\n", "routine", "ns/call", "cycles", "heap", "commands",
+				"data", "nibbles", "bus wait");
+	measure("LCDWriteInt", bench_write_int);
+	measure("float_to_string", bench_float_to_string);
+	measure("string_to_integer", bench_string_to_integer);
+	measure("lcd_printf", bench_printf);
+	measure("lcd_printf_P", bench_printf_P);
+	measure("lcd_puts", bench_puts);
+	measure("lcd_puts_P", bench_puts_P);
+
+	if(!csv)
+		printf("\n%-20s\n", "screen update");
+	stats_init(0);
+	for(uint32_t i = 1; i <= 100; ++i)
+		stats_sample(11400 + i % 1400, 500, 0, i * 1000);
+	measure("page_battery_low", page_battery_low);
+	measure("page_charging", page_charging);
+	measure("page_stats", page_stats);
+	measure("countdown_page", countdown_page);
+	measure("countdown_tick", countdown_tick);
+
+	graph_init();
+	for(int i = 0; i < GRAPH_SPARK_SAMPLES; ++i)
+		graph_spark_add(10440 - i);
+	measure("page_dashboard", page_dashboard);
+	measure("dashboard_update", dashboard_update);
+	lcd_set_geometry(20, 4);
+	gDashboard_Shown = 0;	//the 20x4 layout is drawn in full once, then updated in place
+	screen_dashboard(&dashboard_status);
+	measure("dashboard_20x4", dashboard_update);
+	return 0;
+}
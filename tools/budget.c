@@ -0,0 +1,579 @@
+/*
+ * budget.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Latency and LCD traffic budgets of the control path, the screens
+ * and the ISRs, checked against fixed scenarios so a change that
+ * makes them slower fails instead of going unnoticed.
+ *
+ * Build:
+ *   cc -O2 -Wall -DLCD_BUS_STATS -I tools/host -I src -o budget tools/budget.c src/lcd.c src/convert.c src/graph.c src/control.c src/messages.c src/screens.c src/stats.c
+ *
+ * Usage:
+ *   budget [-v] [profile.txt]
+ *   telemetry_decode -P /dev/ttyUSB0 > profile.txt
+ *
+ * The scenarios (discharge, charge, load priority at raised SOC
+ * limits, menu navigation, count down expiry and calibration) run
+ * the firmware's control decisions sample by sample and draw its
+ * screens with the routines of screens.c, the same code as the
+ * firmware. They measure how many samples the protection takes to
+ * react, the worst-case time from a threshold crossing to the
+ * reaction, the LCD bytes and bus wait of every screen refresh and
+ * whether a calibration fit can overflow. None of these depend on
+ * the host.
+ * The cycle budgets of the ISR and the main loop come from the
+ * profiling probes of a unit built with PROFILING, read from the
+ * output of telemetry_decode -P. They are skipped without it.
+ *
+ * Every measurement is printed with its budget, -v prints the passing
+ * ones too. The exceeded budgets are listed again as a diff of the
+ * budget against the measurement, and the exit status is 1.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lcd.h"
+#include "convert.h"
+#include "graph.h"
+#include "control.h"
+#include "events.h"
+#include "messages.h"
+#include "screens.h"
+#include "stats.h"
+
+#define SOC_LIMIT 50	//DEFAULT_SOC_VALUE in defs.h
+#define MAX_MEASUREMENTS 64
+
+struct budget
+{
+	const char *name;	//scenario.metric
+	uint32_t limit;	//the measurement may not be above it
+	const char *unit;
+};
+
+/* The budgets. A sample is a run of battery_manager, the reaction times
+ * are from the sample that crosses a threshold to the output being
+ * switched. The LCD bytes are the commands and characters sent for
+ * a single refresh of a screen, the wait is the time the LCD driver
+ * spends in its busy waits for them (unit = us).
+ */
+static const struct budget budgets[] =
+{
+	{ "discharge.load_off_samples", 1, "samples" },
+	{ "discharge.buzzer_on_samples", 1, "samples" },
+	{ "discharge.shed_samples", 1, "samples" },
+	{ "discharge.protection_ms", 40, "ms" },
+	{ "discharge.dashboard_bytes", 48, "bytes" },
+	{ "discharge.dashboard_wait_us", 4000, "us" },
+	{ "discharge.dashboard_full_bytes", 64, "bytes" },
+	{ "discharge.dashboard_full_wait_us", 7600, "us" },
+	{ "discharge.low_page_bytes", 22, "bytes" },
+	{ "discharge.low_page_wait_us", 4000, "us" },
+	{ "charge.charge_on_samples", 1, "samples" },
+	{ "charge.charge_off_samples", 1, "samples" },
+	{ "charge.restore_samples", 1, "samples" },
+	{ "charge.page_bytes", 32, "bytes" },
+	{ "charge.page_wait_us", 4800, "us" },
+	{ "priority.inverted_samples", 0, "samples" },
+	{ "menu.screen_bytes", 40, "bytes" },
+	{ "menu.screen_wait_us", 5600, "us" },
+	{ "menu.key_echo_bytes", 40, "bytes" },
+	{ "menu.key_echo_wait_us", 2800, "us" },
+	{ "menu.navigation_bytes", 200, "bytes" },
+	{ "countdown.page_bytes", 24, "bytes" },
+	{ "countdown.page_wait_us", 4000, "us" },
+	{ "countdown.tick_bytes", 4, "bytes" },
+	{ "countdown.tick_wait_us", 320, "us" },
+	{ "countdown.expiry_bytes", 20, "bytes" },
+	{ "countdown.expiry_wait_us", 1600, "us" },
+	{ "calibration.nominal_error_mv", 1, "mV" },
+	{ "calibration.overflow_readings", 0, "readings" },
+	{ "profile.TIMER1_COMPA_vect_max", 1200, "cycles" },	//a tenth of the system tick
+	{ "profile.background_tasks_max", 12000, "cycles" },	//a system tick
+	{ "profile.led_display_max", 2400, "cycles" },
+	{ "profile.battery_manager_max", 240000, "cycles" },	//20ms, it runs from the background tasks
+};
+#define BUDGET_COUNT (sizeof(budgets) / sizeof(budgets[0]))
+
+struct measurement
+{
+	const char *name;
+	uint32_t value;
+};
+
+
+static struct measurement measurements[MAX_MEASUREMENTS];
+static int measurement_count = 0;
+
+
+static void record(const char *name, uint32_t value)
+{
+	//the worst value of every measurement is kept
+	for(int i = 0; i < measurement_count; ++i)
+	{
+		if(!strcmp(measurements[i].name, name))
+		{
+			if(value > measurements[i].value)
+				measurements[i].value = value;
+			return;
+		}
+	}
+	if(measurement_count < MAX_MEASUREMENTS)
+	{
+		measurements[measurement_count].name = strdup(name);
+		measurements[measurement_count].value = value;
+		++measurement_count;
+	}
+}
+
+
+static void refresh(const char *scenario, const char *screen, void (*draw)(void))
+{
+	//a single refresh of a screen, its bus traffic is recorded as scenario.screen_bytes and _wait_us
+	char name[64];
+	memset(&lcd_bus_stats, 0, sizeof(lcd_bus_stats));
+	draw();
+	snprintf(name, sizeof(name), "%s.%s_bytes", scenario, screen);
+	record(name, lcd_bus_stats.commands + lcd_bus_stats.data);
+	snprintf(name, sizeof(name), "%s.%s_wait_us", scenario, screen);
+	record(name, lcd_bus_stats.wait_us);
+}
+
+
+//the screens of screens.c, drawn with what the firmware would show at this point of a scenario
+static struct screen_status screen = { 0, 0, SOC_LIMIT, SCREEN_STATE_LOAD_ON, 0 };
+static char screen_input_digits[4];
+
+static void dashboard(void)
+{
+	screen_dashboard(&screen);
+}
+
+
+static void low_page(void)
+{
+	screen_low_page(screen.soc);
+}
+
+
+static void charging_page(void)
+{
+	screen_charging_page(screen.soc);
+}
+
+
+static void menu_options(void)
+{
+	screen_prompt(gMsg_Menu_Soc_Limit, gMsg_Menu_Timer);
+}
+
+
+static void menu_calibrate(void)
+{
+	screen_prompt(gMsg_Menu_Calibrate, NULL);
+}
+
+
+static void menu_cancel(void)
+{
+	screen_prompt(gMsg_Press_Cancel, NULL);
+}
+
+
+static void menu_echo(void)
+{
+	screen_key('1');
+}
+
+
+static void soc_limit_prompt(void)
+{
+	screen_prompt(gMsg_Soc_Limit_Value, NULL);
+}
+
+
+static void soc_limit_key(void)
+{
+	screen_input(6, 1, screen_input_digits, gMsg_Percent);
+}
+
+
+static void countdown_page(void)
+{
+	screen_countdown(90, 59);
+}
+
+
+static void countdown_tick(void)
+{
+	screen_countdown_tick(90, 42);
+}
+
+
+static void countdown_expiry(void)
+{
+	screen_countdown_expired();
+}
+
+
+static uint8_t has_event(const uint8_t *events, uint8_t count, uint8_t code)
+{
+	for(uint8_t i = 0; i < count; ++i)
+		if(events[i] == code)
+			return 1;
+	return 0;
+}
+
+
+static void discharge(void)
+{
+	/* The battery runs down from 90% to 20% with the load on, one
+	 * sample per run of battery_manager at the rate it picks. The
+	 * samples from the first one below a threshold to the one that
+	 * switches the output are counted. The screens are refreshed
+	 * after every sample: the dashboard, and the BATTERY LOW page
+	 * once the battery is low.
+	 */
+	struct control_policy policy;
+	struct control_state state = { 1, 0, 0, 0, 0 };
+	control_policy_init(&policy, SOC_LIMIT);
+	uint8_t outputs = gLoad_Channels[0].mask | gLoad_Channels[1].mask | gLoad_Channels[2].mask;
+	uint32_t low_since = 0, buzzer_since = 0, shed_since[LOAD_CHANNEL_COUNT] = { 0 };
+	uint32_t low_ms = 0, worst_refresh = 0;
+	uint16_t period = CONTROL_SLOW_PERIOD;	//time from the previous sample to this one
+	uint8_t previous_soc = 0;
+
+	graph_init();
+	gDashboard_Shown = 0;
+	for(uint32_t sample = 1; sample <= 700; ++sample)
+	{
+		uint16_t millivolts = CONTROL_MAX_MILLIVOLTS * (900 - sample) / 1000;
+		uint8_t soc = control_soc(millivolts);
+		uint8_t events[CONTROL_MAX_EVENTS];
+		uint8_t count = control_step(&policy, &state, soc, 0, events);
+
+		if(soc < policy.soc_limit && !low_since)
+			low_since = sample;
+		if(low_since && state.load_on)
+			low_ms += period;	//the SOC may have crossed the limit right after the previous sample
+		if(has_event(events, count, EVENT_LOAD_OFF))
+		{
+			record("discharge.load_off_samples", sample - low_since + 1);
+			low_ms += period;
+		}
+		if(soc < policy.buzzer_soc && !buzzer_since)
+			buzzer_since = sample;
+		if(has_event(events, count, EVENT_BUZZER_ON))
+			record("discharge.buzzer_on_samples", sample - buzzer_since + 1);
+
+		uint8_t shed = control_shed(&policy, gLoad_Channels, LOAD_CHANNEL_COUNT, outputs, soc);
+		for(uint8_t i = 0; i < LOAD_CHANNEL_COUNT; ++i)
+		{
+			if(soc < control_load_soc(&policy, gLoad_Channels[i].cutoff_margin) && !shed_since[i])
+				shed_since[i] = sample;
+			if((outputs & ~shed) & gLoad_Channels[i].mask)
+				record("discharge.shed_samples", sample - shed_since[i] + 1);
+		}
+		outputs = shed;
+
+		screen.soc = soc;
+		screen.millivolts = millivolts;
+		screen.state = state.battery_low ? SCREEN_STATE_LOW : state.load_on ? SCREEN_STATE_LOAD_ON : SCREEN_STATE_LOAD_OFF;
+		screen.outputs = outputs;
+		graph_spark_add(millivolts);
+		if(state.battery_low)
+		{
+			refresh("discharge", "low_page", low_page);
+			if(lcd_bus_stats.wait_us > worst_refresh)
+				worst_refresh = lcd_bus_stats.wait_us;
+		}
+		//the dashboard is drawn in full after another page, the same as battery_display
+		refresh("discharge", gDashboard_Shown ? "dashboard" : "dashboard_full", dashboard);
+		if(lcd_bus_stats.wait_us > worst_refresh)
+			worst_refresh = lcd_bus_stats.wait_us;
+
+		uint8_t change = (soc > previous_soc) ? soc - previous_soc : previous_soc - soc;
+		period = control_sample_period(&policy, gLoad_Channels, LOAD_CHANNEL_COUNT, soc, change, period);
+		previous_soc = soc;
+	}
+
+	/* The samples counted above are spaced by the periods picked by
+	 * control_sample_period. A sample is taken by the background
+	 * tasks, which can also be held back for a system tick and the
+	 * slowest screen refresh.
+	 */
+	record("discharge.protection_ms", low_ms + 1 + (worst_refresh + 999) / 1000);
+}
+
+
+static void charge(void)
+{
+	/* External power is connected to a battery at 30%, which is
+	 * then charged up to 100%. Charging has to start on the first
+	 * sample, stop on the first one at the stop SOC and the load
+	 * channels have to be connected again one per sample.
+	 */
+	struct control_policy policy;
+	struct control_state state = { 0, 0, 0, 0, 0 };
+	control_policy_init(&policy, SOC_LIMIT);
+	uint8_t outputs = 0;
+	uint32_t stop_since = 0, restore_since[LOAD_CHANNEL_COUNT] = { 0 };
+
+	for(uint32_t sample = 1; sample <= 700; ++sample)
+	{
+		uint16_t millivolts = CONTROL_MAX_MILLIVOLTS * (300 + sample) / 1000;
+		uint8_t soc = control_soc(millivolts);
+		uint8_t events[CONTROL_MAX_EVENTS];
+		uint8_t count = control_step(&policy, &state, soc, 1, events);
+
+		if(has_event(events, count, EVENT_CHARGE_ON) && sample < 100)
+			record("charge.charge_on_samples", sample);
+		if(soc >= policy.charge_stop_soc && !stop_since)
+			stop_since = sample;
+		if(has_event(events, count, EVENT_CHARGE_OFF))
+			record("charge.charge_off_samples", sample - stop_since + 1);
+
+		uint8_t restored = control_shed(&policy, gLoad_Channels, LOAD_CHANNEL_COUNT, outputs, soc);
+		for(uint8_t i = 0; i < LOAD_CHANNEL_COUNT; ++i)
+		{
+			if(soc >= control_load_soc(&policy, gLoad_Channels[i].reconnect_margin) && !restore_since[i])
+				restore_since[i] = sample;
+			if((restored & ~outputs) & gLoad_Channels[i].mask)
+				record("charge.restore_samples", sample - restore_since[i] + 1);
+		}
+		outputs = restored;
+
+		screen.soc = soc;
+		refresh("charge", "page", charging_page);
+	}
+}
+
+
+static void priority(void)
+{
+	/* The battery runs down from 100% to 0% and is charged back up
+	 * with the SOC limit raised from the keypad or over Modbus. The
+	 * samples where a load channel is still on while the main load
+	 * is off are counted, at any limit there must be none.
+	 */
+	static const uint8_t limits[] = { 56, 75, 90, 99 };
+	uint32_t inverted = 0;
+	for(size_t n = 0; n < sizeof(limits); ++n)
+	{
+		struct control_policy policy;
+		struct control_state state = { 1, 0, 0, 0, 0 };
+		control_policy_init(&policy, limits[n]);
+		uint8_t outputs = gLoad_Channels[0].mask | gLoad_Channels[1].mask | gLoad_Channels[2].mask;
+		for(uint32_t sample = 0; sample <= 2000; ++sample)
+		{
+			uint8_t external_power = sample > 1000;
+			uint32_t permille = external_power ? sample - 1000 : 1000 - sample;
+			uint8_t soc = control_soc(CONTROL_MAX_MILLIVOLTS * permille / 1000);
+			uint8_t events[CONTROL_MAX_EVENTS];
+			control_step(&policy, &state, soc, external_power, events);
+			outputs = control_shed(&policy, gLoad_Channels, LOAD_CHANNEL_COUNT, outputs, soc);
+			if(outputs && !state.load_on)
+				++inverted;
+		}
+	}
+	record("priority.inverted_samples", inverted);
+}
+
+
+static void menu(void)
+{
+	//* is pressed, option 1 is chosen and an SOC limit of 45 is typed
+	uint32_t total = 0;
+	void (*screens[])(void) = { menu_options, menu_calibrate, menu_cancel, soc_limit_prompt };
+	for(size_t i = 0; i < sizeof(screens) / sizeof(screens[0]); ++i)
+	{
+		refresh("menu", "screen", screens[i]);
+		total += lcd_bus_stats.commands + lcd_bus_stats.data;
+		if(screens[i] == menu_cancel)
+		{
+			refresh("menu", "key_echo", menu_echo);
+			total += lcd_bus_stats.commands + lcd_bus_stats.data;
+		}
+	}
+	const char *typed[] = { "4", "45" };
+	for(int i = 0; i < 2; ++i)
+	{
+		strcpy(screen_input_digits, typed[i]);
+		refresh("menu", "key_echo", soc_limit_key);
+		total += lcd_bus_stats.commands + lcd_bus_stats.data;
+	}
+	record("menu.navigation_bytes", total);
+}
+
+
+static uint32_t calibration_overflows(const struct control_calibration *calibration)
+{
+	//readings of a fit where control_calibrate's 32 bit sum overflows or leaves 0 - the highest calibration point
+	uint32_t overflows = 0;
+	for(int64_t adc = 0; adc <= 1023; ++adc)
+	{
+		int64_t scaled = adc * calibration->gain + calibration->offset;
+		if(scaled > INT32_MAX || scaled < 0
+				|| (scaled >> CONTROL_CALIBRATION_SHIFT) > CONTROL_CALIBRATION_MAX_MILLIVOLTS
+				|| control_calibrate(calibration, adc) != (scaled >> CONTROL_CALIBRATION_SHIFT))
+			++overflows;
+	}
+	return overflows;
+}
+
+
+static void calibration(void)
+{
+	/* A fit through two points of the nominal scale has to give
+	 * the nominal readings back. Every fit accepted from a grid of
+	 * points over the whole ADC and keypad range, mistyped ones
+	 * included, has to be read back within 32 bits at every ADC
+	 * reading. The grid holds the fit of (0, 20000mV) and
+	 * (100, 21466mV), which once read a full battery as 0mV.
+	 */
+	struct control_calibration fit;
+	uint32_t error = 0, overflows = 0;
+	if(control_calibration_fit(&fit, 100, control_millivolts(100), 900, control_millivolts(900)))
+	{
+		for(uint16_t adc = 0; adc <= 1023; ++adc)
+		{
+			int32_t difference = (int32_t)control_calibrate(&fit, adc) - control_millivolts(adc);
+			if((uint32_t)abs(difference) > error)
+				error = abs(difference);
+		}
+	}
+	else
+		error = CONTROL_MAX_MILLIVOLTS;
+	record("calibration.nominal_error_mv", error);
+
+	if(control_calibration_fit(&fit, 0, 20000, 100, 21466))
+		overflows += calibration_overflows(&fit);
+	for(uint16_t adc_low = 0; adc_low <= 1023; adc_low += 31)
+		for(uint16_t adc_high = adc_low + CONTROL_CALIBRATION_MIN_SPAN; adc_high <= 1023; adc_high += 31)
+			for(uint32_t low = 0; low <= 26000; low += 650)
+				for(uint32_t high = low + 50; high <= 26000; high += 650)
+					if(control_calibration_fit(&fit, adc_low, low, adc_high, high))
+						overflows += calibration_overflows(&fit);
+	record("calibration.overflow_readings", overflows);
+}
+
+
+static void countdown(void)
+{
+	//a count down is started, ticks every second and expires
+	refresh("countdown", "page", countdown_page);
+	for(int i = 0; i < 60; ++i)
+		refresh("countdown", "tick", countdown_tick);
+	refresh("countdown", "expiry", countdown_expiry);
+}
+
+
+static int read_profile(const char *path)
+{
+	//the probe lines of telemetry_decode -P, all in cycles
+	FILE *file = fopen(path, "r");
+	if(!file)
+	{
+		perror(path);
+		return 0;
+	}
+	char line[256], probe[32], name[64];
+	unsigned count, min, max, mean;
+	while(fgets(line, sizeof(line), file))
+	{
+		if(sscanf(line, " profile %31s n=%u min=%u max=%u mean=%u", probe, &count, &min, &max, &mean) != 5)
+			continue;
+		snprintf(name, sizeof(name), "profile.%s_max", probe);
+		record(name, max);
+	}
+	fclose(file);
+	return 1;
+}
+
+
+static const struct measurement* find_measurement(const char *name)
+{
+	for(int i = 0; i < measurement_count; ++i)
+		if(!strcmp(measurements[i].name, name))
+			return &measurements[i];
+	return NULL;
+}
+
+
+int main(int argc, char **argv)
+{
+	int verbose = 0;
+	const char *profile = NULL;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "-v"))
+			verbose = 1;
+		else if(argv[i][0] != '-')
+			profile = argv[i];
+		else
+		{
+			fprintf(stderr, "usage: %s [-v] [profile.txt]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	stats_init(0);
+	discharge();
+	charge();
+	priority();
+	menu();
+	countdown();
+	calibration();
+	if(profile && !read_profile(profile))
+		return 1;
+
+	int failed = 0, skipped = 0;
+	for(size_t i = 0; i < BUDGET_COUNT; ++i)
+	{
+		const struct budget *b = &budgets[i];
+		const struct measurement *m = find_measurement(b->name);
+		if(!m)
+		{
+			++skipped;
+			if(verbose)
+				printf("  skip  %-32s %10u %-7s not measured\n", b->name, b->limit, b->unit);
+			continue;
+		}
+		if(m->value > b->limit)
+		{
+			++failed;
+			printf("  FAIL  %-32s %10u %-7s budget %u\n", b->name, m->value, b->unit, b->limit);
+		}
+		else if(verbose)
+			printf("  ok    %-32s %10u %-7s budget %u\n", b->name, m->value, b->unit, b->limit);
+	}
+	for(int i = 0; i < measurement_count; ++i)
+	{
+		//a measurement without a budget is most likely a misspelt name
+		int found = 0;
+		for(size_t n = 0; n < BUDGET_COUNT; ++n)
+			found |= !strcmp(budgets[n].name, measurements[i].name);
+		if(!found && strncmp(measurements[i].name, "profile.", 8))
+			printf("  note  %-32s %10u         has no budget\n", measurements[i].name, measurements[i].value);
+	}
+
+	if(failed)
+	{
+		printf("\n--- budget\n+++ measured\n");
+		for(size_t i = 0; i < BUDGET_COUNT; ++i)
+		{
+			const struct measurement *m = find_measurement(budgets[i].name);
+			if(!m || m->value <= budgets[i].limit)
+				continue;
+			printf("-%-32s %10u %s\n", budgets[i].name, budgets[i].limit, budgets[i].unit);
+			printf("+%-32s %10u %s (+%u, +%.0f%%)\n", budgets[i].name, m->value, budgets[i].unit,
+					m->value - budgets[i].limit, 100.0 * (m->value - budgets[i].limit) / budgets[i].limit);
+		}
+	}
+	printf("%zu budgets: %zu passed, %d failed, %d skipped%s\n", BUDGET_COUNT, BUDGET_COUNT - failed - skipped,
+			failed, skipped, skipped && !profile ? " (no profile given)" : "");
+	return failed ? 1 : 0;
+}
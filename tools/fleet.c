@@ -0,0 +1,415 @@
+/*
+ * fleet.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Fleet simulator: runs thousands of independent BatteryBot instances,
+ * each one the firmware's control decisions (src/control.c) and running
+ * statistics (src/stats.c) closed around a simple battery model, on all
+ * cores and aggregates the results of every policy.
+ *
+ * Build:
+ *   cc -O2 -Wall -pthread -I src -o fleet tools/fleet.c src/control.c src/stats.c
+ *
+ * Usage:
+ *   fleet [-n units] [-d days] [-s sample_seconds] [-t threads] [-f profiles.csv]
+ *         [-l limit[,buzzer,charge_start,charge_stop,hysteresis]] ...
+ *
+ * Every unit has its own load profile. They are either drawn at random
+ * (the same fleet for every run) or read from a CSV file with a
+ * "capacity_ah,base_a,peak_a,charger_a,charge_from_h,charge_to_h" line
+ * per unit: a base load around the clock, an extra peak load from 18:00
+ * to 23:00 and a charger that is available between the given hours.
+ * Every -l adds a policy, each policy is run against the whole fleet.
+ *
+ * A unit simulation is a task. The tasks are spread over per-thread
+ * deques, a thread takes work from the bottom of its own deque and
+ * steals from the top of the others' once it runs dry. Units share
+ * nothing, so the throughput scales with the number of cores.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "control.h"
+#include "events.h"
+#include "stats.h"
+
+#define MAX_POLICIES 16
+#define MAX_THREADS 256
+#define DEFAULT_SOC_LIMIT 50	//DEFAULT_SOC_VALUE in defs.h
+#define PEAK_FROM_HOUR 18
+#define PEAK_TO_HOUR 23
+
+struct profile
+{
+	double capacity;	//unit = Ah
+	double base_current;	//unit = A
+	double peak_current;
+	double charger_current;
+	int charge_from;	//hour of the day
+	int charge_to;
+};
+
+struct result
+{
+	uint32_t cutoffs;
+	uint32_t charge_cycles;
+	uint32_t low_seconds;
+	uint32_t milli_amp_hours;
+	uint32_t buzzer_seconds;
+	uint32_t load_off_seconds;
+	uint8_t min_soc;
+};
+
+struct task_deque
+{
+	pthread_mutex_t lock;
+	int *tasks;
+	int top;	//next task to be stolen
+	int bottom;	//one past the next task taken by the owner
+};
+
+struct fleet
+{
+	int units;
+	int policy_count;
+	struct control_policy policies[MAX_POLICIES];
+	struct profile *profiles;
+	struct result *results;	//one per task, policy major
+	uint32_t samples;	//samples per unit
+	uint32_t period;	//unit = ms
+	int threads;
+	struct task_deque deques[MAX_THREADS];
+};
+
+struct worker
+{
+	struct fleet *fleet;
+	int index;
+	uint64_t steals;
+};
+
+
+static uint32_t xorshift(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+
+static void random_profile(struct profile *profile, uint32_t seed)
+{
+	//a spread of small solar, grid and generator backed installations
+	uint32_t state = seed * 2654435761u + 1;
+	profile->capacity = 50 + xorshift(&state) % 151;
+	profile->base_current = 0.5 + (xorshift(&state) % 40) / 10.0;
+	profile->peak_current = (xorshift(&state) % 80) / 10.0;
+	profile->charger_current = 5 + xorshift(&state) % 26;
+	switch(xorshift(&state) % 3)
+	{
+		case 0: profile->charge_from = 8; profile->charge_to = 17; break;	//solar
+		case 1: profile->charge_from = 0; profile->charge_to = 6; break;	//night tariff grid
+		default: profile->charge_from = 18; profile->charge_to = 22; break;	//evening generator
+	}
+}
+
+
+static int read_profiles(const char *path, struct profile **profiles)
+{
+	FILE *file = fopen(path, "r");
+	if(!file)
+	{
+		perror(path);
+		exit(1);
+	}
+	int count = 0, size = 0;
+	char line[256];
+	struct profile profile;
+	while(fgets(line, sizeof(line), file))
+	{
+		if(sscanf(line, "%lf,%lf,%lf,%lf,%d,%d", &profile.capacity, &profile.base_current, &profile.peak_current,
+				&profile.charger_current, &profile.charge_from, &profile.charge_to) != 6)
+			continue;	//header or comment line
+		if(count == size)
+		{
+			size = size ? 2 * size : 1024;
+			*profiles = realloc(*profiles, size * sizeof(**profiles));
+		}
+		(*profiles)[count++] = profile;
+	}
+	fclose(file);
+	return count;
+}
+
+
+static void simulate(const struct fleet *fleet, int task, struct result *result)
+{
+	/* One unit under one policy. Everything the unit needs lives
+	 * on this stack frame, the control state and the statistics
+	 * are exactly what the firmware keeps in its globals.
+	 */
+	const struct control_policy *policy = &fleet->policies[task / fleet->units];
+	const struct profile *profile = &fleet->profiles[task % fleet->units];
+	struct control_state state = { 0, 0, 0, 0, 0 };
+	struct battery_stats stats;
+	stats_reset(&stats, 0);
+	uint32_t noise = (task % fleet->units) + 1;
+	double charge = profile->capacity * 0.8;	//unit = Ah
+	double hours_per_sample = fleet->period / 3600000.0;
+	uint8_t min_soc = 100;
+	memset(result, 0, sizeof(*result));
+
+	for(uint32_t i = 0; i < fleet->samples; ++i)
+	{
+		//the simulated time runs past the 49.7 days of a 32 bit ms count, the firmware's tick wraps there
+		uint64_t now = (uint64_t)i * fleet->period;
+		int hour = (now / 3600000u) % 24;
+		uint8_t external_power = (profile->charge_from <= profile->charge_to)
+				? hour >= profile->charge_from && hour < profile->charge_to
+				: hour >= profile->charge_from || hour < profile->charge_to;
+
+		//the battery voltage follows the charge, with some ADC noise on top
+		double load = state.load_on ? profile->base_current
+				+ ((hour >= PEAK_FROM_HOUR && hour < PEAK_TO_HOUR) ? profile->peak_current : 0) : 0;
+		double current = (state.charging && external_power ? profile->charger_current : 0) - load;
+		charge += current * hours_per_sample;
+		if(charge > profile->capacity)
+			charge = profile->capacity;
+		if(charge < 0)
+			charge = 0;
+		int32_t millivolts = charge / profile->capacity * CONTROL_MAX_MILLIVOLTS + (int32_t)(xorshift(&noise) % 41) - 20;
+		if(millivolts < 0)
+			millivolts = 0;
+		uint8_t soc = control_soc(millivolts);
+		if(soc < min_soc)
+			min_soc = soc;
+
+		stats_add_sample(&stats, millivolts, load * 1000, soc < policy->soc_limit, (uint32_t)now);
+		if(state.buzzer_on)
+			result->buzzer_seconds += fleet->period / 1000;
+		if(!state.load_on)
+			result->load_off_seconds += fleet->period / 1000;
+
+		uint8_t events[CONTROL_MAX_EVENTS];
+		uint8_t count = control_step(policy, &state, soc, external_power, events);
+		for(uint8_t e = 0; e < count; ++e)
+		{
+			if(events[e] == EVENT_LOAD_OFF)
+				++stats.cutoffs;
+			else if(events[e] == EVENT_CHARGE_ON)
+				++stats.charge_cycles;
+		}
+	}
+
+	result->cutoffs = stats.cutoffs;
+	result->charge_cycles = stats.charge_cycles;
+	result->low_seconds = stats.low_seconds;
+	result->milli_amp_hours = stats.milli_amp_hours;
+	result->min_soc = min_soc;
+}
+
+
+static int take_task(struct task_deque *deque, int steal)
+{
+	//the owner takes from the bottom, thieves from the top, -1 when empty
+	int task = -1;
+	pthread_mutex_lock(&deque->lock);
+	if(deque->top < deque->bottom)
+		task = steal ? deque->tasks[deque->top++] : deque->tasks[--deque->bottom];
+	pthread_mutex_unlock(&deque->lock);
+	return task;
+}
+
+
+static void* work(void *argument)
+{
+	struct worker *worker = argument;
+	struct fleet *fleet = worker->fleet;
+	for(;;)
+	{
+		int task = take_task(&fleet->deques[worker->index], 0);
+		for(int i = 1; task < 0 && i < fleet->threads; ++i)
+		{
+			task = take_task(&fleet->deques[(worker->index + i) % fleet->threads], 1);
+			if(task >= 0)
+				++worker->steals;
+		}
+		if(task < 0)
+			break;	//every deque is empty and no new tasks are ever added
+		simulate(fleet, task, &fleet->results[task]);
+	}
+	return NULL;
+}
+
+
+static void add_policy(struct fleet *fleet, const char *spec)
+{
+	if(fleet->policy_count == MAX_POLICIES)
+	{
+		fprintf(stderr, "at most %d policies\n", MAX_POLICIES);
+		exit(1);
+	}
+	struct control_policy *policy = &fleet->policies[fleet->policy_count++];
+	unsigned limit = DEFAULT_SOC_LIMIT, buzzer = CONTROL_BUZZER_SOC;
+	unsigned start = CONTROL_CHARGE_START_SOC, stop = CONTROL_CHARGE_STOP_SOC, hysteresis = CONTROL_HYSTERESIS;
+	if(spec)
+		sscanf(spec, "%u,%u,%u,%u,%u", &limit, &buzzer, &start, &stop, &hysteresis);
+	control_policy_init(policy, limit);
+	policy->buzzer_soc = buzzer;
+	policy->charge_start_soc = start;
+	policy->charge_stop_soc = stop;
+	policy->hysteresis = hysteresis;
+}
+
+
+static int compare(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+
+
+static void report(const struct fleet *fleet, int p)
+{
+	const struct control_policy *policy = &fleet->policies[p];
+	const struct result *results = &fleet->results[p * fleet->units];
+	uint64_t cutoffs = 0, charges = 0, low = 0, buzzer = 0, off = 0, amp_hours = 0;
+	int affected = 0, flat = 0;
+	uint32_t *sorted = malloc(fleet->units * sizeof(*sorted));
+	for(int u = 0; u < fleet->units; ++u)
+	{
+		cutoffs += results[u].cutoffs;
+		charges += results[u].charge_cycles;
+		low += results[u].low_seconds;
+		buzzer += results[u].buzzer_seconds;
+		off += results[u].load_off_seconds;
+		amp_hours += results[u].milli_amp_hours;
+		affected += results[u].cutoffs != 0;
+		flat += results[u].min_soc < 20;
+		sorted[u] = results[u].cutoffs;
+	}
+	qsort(sorted, fleet->units, sizeof(*sorted), compare);
+
+	double days = (double)fleet->samples * fleet->period / 86400000.0;
+	printf("policy %d limit=%u+%u%% buzzer=%u%% charge=%u-%u%%\n", p, policy->soc_limit, policy->hysteresis,
+			policy->buzzer_soc, policy->charge_start_soc, policy->charge_stop_soc);
+	printf("  cutoffs     %.2f per unit-day, units affected %d/%d, p50 %u p95 %u max %u per unit\n",
+			cutoffs / (fleet->units * days), affected, fleet->units, sorted[fleet->units / 2],
+			sorted[fleet->units * 95 / 100], sorted[fleet->units - 1]);
+	printf("  low state   %.2f h per unit-day, load off %.2f h per unit-day, buzzer %.2f h per unit-day\n",
+			low / 3600.0 / (fleet->units * days), off / 3600.0 / (fleet->units * days),
+			buzzer / 3600.0 / (fleet->units * days));
+	printf("  charging    %.2f cycles per unit-day, %.1f Ah delivered per unit-day, %d units below 20%% SOC\n",
+			charges / (fleet->units * days), amp_hours / 1000.0 / (fleet->units * days), flat);
+	free(sorted);
+}
+
+
+int main(int argc, char **argv)
+{
+	static struct fleet fleet;
+	int units = 1000;
+	double days = 7, period = 10;
+	const char *path = NULL;
+	fleet.threads = sysconf(_SC_NPROCESSORS_ONLN);
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "-n") && i + 1 < argc)
+			units = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-d") && i + 1 < argc)
+			days = atof(argv[++i]);
+		else if(!strcmp(argv[i], "-s") && i + 1 < argc)
+			period = atof(argv[++i]);
+		else if(!strcmp(argv[i], "-t") && i + 1 < argc)
+			fleet.threads = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-f") && i + 1 < argc)
+			path = argv[++i];
+		else if(!strcmp(argv[i], "-l") && i + 1 < argc)
+			add_policy(&fleet, argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [-n units] [-d days] [-s sample_seconds] [-t threads] [-f profiles.csv]\n"
+					"       [-l limit[,buzzer,charge_start,charge_stop,hysteresis]] ...\n", argv[0]);
+			return 1;
+		}
+	}
+	if(!fleet.policy_count)
+		add_policy(&fleet, NULL);
+	if(fleet.threads < 1)
+		fleet.threads = 1;
+	if(fleet.threads > MAX_THREADS)
+		fleet.threads = MAX_THREADS;
+
+	if(path)
+		units = read_profiles(path, &fleet.profiles);
+	else
+	{
+		fleet.profiles = malloc(units * sizeof(*fleet.profiles));
+		for(int u = 0; u < units; ++u)
+			random_profile(&fleet.profiles[u], u);
+	}
+	if(units < 1 || period <= 0 || days <= 0)
+	{
+		fprintf(stderr, "nothing to simulate\n");
+		return 1;
+	}
+	if(period < 0.001 || days * 86400000.0 / (uint32_t)(period * 1000) > UINT32_MAX)
+	{
+		fprintf(stderr, "the sample period must be at least 1ms and give at most %u samples\n", UINT32_MAX);
+		return 1;
+	}
+	fleet.units = units;
+	fleet.period = period * 1000;
+	fleet.samples = days * 86400000.0 / fleet.period;
+	int tasks = units * fleet.policy_count;
+	fleet.results = malloc(tasks * sizeof(*fleet.results));
+
+	//deal the tasks out round-robin, stealing evens out whatever imbalance is left
+	for(int t = 0; t < fleet.threads; ++t)
+	{
+		struct task_deque *deque = &fleet.deques[t];
+		pthread_mutex_init(&deque->lock, NULL);
+		deque->tasks = malloc((tasks / fleet.threads + 1) * sizeof(int));
+		deque->top = deque->bottom = 0;
+	}
+	for(int task = 0; task < tasks; ++task)
+	{
+		struct task_deque *deque = &fleet.deques[task % fleet.threads];
+		deque->tasks[deque->bottom++] = task;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pthread_t threads[MAX_THREADS];
+	struct worker workers[MAX_THREADS];
+	for(int t = 0; t < fleet.threads; ++t)
+	{
+		workers[t].fleet = &fleet;
+		workers[t].index = t;
+		workers[t].steals = 0;
+		pthread_create(&threads[t], NULL, work, &workers[t]);
+	}
+	uint64_t steals = 0;
+	for(int t = 0; t < fleet.threads; ++t)
+	{
+		pthread_join(threads[t], NULL);
+		steals += workers[t].steals;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	double steps = (double)tasks * fleet.samples;
+	printf("%d units x %d policies, %.1f days at %.0fs per sample: %.0f control steps in %.3f s on %d threads "
+			"(%.1fM steps/s, %llu steals)\n", units, fleet.policy_count, days, period, steps, seconds, fleet.threads,
+			steps / seconds / 1e6, (unsigned long long)steals);
+	for(int p = 0; p < fleet.policy_count; ++p)
+		report(&fleet, p);
+	return 0;
+}
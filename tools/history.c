@@ -0,0 +1,304 @@
+/*
+ * history.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Bulk reader of the battery history kept in the serial flash by the
+ * data logger (src/datalog.h), from an image of the flash read out
+ * with a flash programmer or written by -w.
+ *
+ * Build:
+ *   cc -O2 -Wall -I src -I tools/host -o history tools/history.c src/datalog.c src/control.c tools/host/flash_file.c
+ *
+ * Usage:
+ *   history [-s | -b] unit.img > history.csv
+ *   history -w unit.img [-p period_ms] < trace.csv
+ *
+ * The samples are printed oldest first as CSV lines of
+ * "time_ms,millivolts,external_power,soc,flags", the format read by
+ * replay. The time starts at 0 with the oldest sample and keeps
+ * running over a power cycle. -b prints the 8 byte binary records of
+ * replay instead, -s only prints a summary. -w runs a replay CSV trace
+ * through the firmware's data logger into an image file (created
+ * blank when missing, appended to otherwise). Every sample goes
+ * through the firmware's control decisions at the default SOC limit,
+ * so the load, charging and buzzer flags are logged as a unit would
+ * log them, e.g.
+ *   replay -g 1000 | history -w unit.img
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "datalog.h"
+#include "control.h"
+#include "frame.h"
+#include "flash_file.h"
+
+#define RECORD_LENGTH 8	//binary trace record of replay
+#define SOC_LIMIT 50	//DEFAULT_SOC_VALUE in defs.h, the policy -w logs the flags of
+
+struct summary
+{
+	uint64_t samples;
+	uint32_t pages;
+	uint32_t boots;
+	uint16_t min_millivolts;
+	uint16_t max_millivolts;
+	uint64_t sum_millivolts;
+	uint64_t load_on_time;	//unit = ms
+	uint64_t charge_time;
+	uint64_t external_time;
+};
+
+static char output[1 << 16];
+static size_t output_length = 0;
+static int mode = 0;	//'s' summary, 'b' binary, 0 CSV
+static struct summary summary = { 0, 0, 0, 0xFFFF, 0, 0, 0, 0, 0 };
+
+
+static void flush_output(void)
+{
+	fwrite(output, 1, output_length, stdout);
+	output_length = 0;
+}
+
+
+static char* put_number(char *p, uint64_t value)
+{
+	char digits[20];
+	int count = 0;
+	do
+	{
+		digits[count++] = '0' + value % 10;
+		value /= 10;
+	} while(value);
+	while(count)
+		*p++ = digits[--count];
+	return p;
+}
+
+
+static void emit(uint64_t time, uint16_t adc, uint8_t flags, uint32_t period)
+{
+	uint16_t millivolts = control_millivolts(adc);
+	uint8_t external = (flags & FRAME_FLAG_EXTERNAL_POWER) != 0;
+	++summary.samples;
+	summary.sum_millivolts += millivolts;
+	if(millivolts < summary.min_millivolts)
+		summary.min_millivolts = millivolts;
+	if(millivolts > summary.max_millivolts)
+		summary.max_millivolts = millivolts;
+	if(flags & FRAME_FLAG_LOAD_ON)
+		summary.load_on_time += period;
+	if(flags & FRAME_FLAG_CHARGING)
+		summary.charge_time += period;
+	if(external)
+		summary.external_time += period;
+
+	if(output_length > sizeof(output) - 64)
+		flush_output();
+	if(mode == 'b')
+	{
+		uint8_t *r = (uint8_t *)output + output_length;
+		r[0] = time;
+		r[1] = time >> 8;
+		r[2] = time >> 16;
+		r[3] = time >> 24;
+		r[4] = millivolts;
+		r[5] = millivolts >> 8;
+		r[6] = external;
+		r[7] = 0;
+		output_length += RECORD_LENGTH;
+	}
+	else if(!mode)
+	{
+		char *p = output + output_length;
+		p = put_number(p, time);
+		*p++ = ',';
+		p = put_number(p, millivolts);
+		*p++ = ',';
+		*p++ = '0' + external;
+		*p++ = ',';
+		p = put_number(p, control_soc(millivolts));
+		*p++ = ',';
+		p = put_number(p, flags);
+		*p++ = '\n';
+		output_length = p - output;
+	}
+}
+
+
+static uint32_t get_u32(const uint8_t *p)
+{
+	return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+static int read_image(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if(!file)
+	{
+		perror(path);
+		return 1;
+	}
+	uint8_t *image = malloc(FLASH_SIZE);
+	size_t size = fread(image, 1, FLASH_SIZE, file);
+	fclose(file);
+	uint32_t count = size / DATALOG_PAGE_SIZE;
+
+	//the newest page has the highest sequence number, the oldest one follows it
+	uint32_t newest = 0, newest_sequence = 0;
+	int written = 0;
+	for(uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t sequence = get_u32(image + i * DATALOG_PAGE_SIZE);
+		if(sequence != DATALOG_ERASED && (!written || sequence > newest_sequence))
+		{
+			newest = i;
+			newest_sequence = sequence;
+			written = 1;
+		}
+	}
+
+	if(!mode)
+		printf("time_ms,millivolts,external_power,soc,flags\n");
+	clock_t started = clock();
+	int64_t offset = 0, next_time = 0;	//offset turns the time since power up into the time since the oldest sample
+	int first = 1;
+	for(uint32_t n = 1; written && n <= count; ++n)
+	{
+		const uint8_t *page = image + ((newest + n) % count) * DATALOG_PAGE_SIZE;
+		if(get_u32(page) == DATALOG_ERASED)
+			continue;
+		uint32_t start = get_u32(page + 4);
+		uint32_t period = page[8] | (page[9] << 8);
+		if(first)
+			offset = -(int64_t)start;
+		else if(start + offset < next_time - (int64_t)period)
+		{
+			//the time since power up went back: the unit has been powered up again
+			offset = next_time - start;
+			++summary.boots;
+		}
+		first = 0;
+		++summary.pages;
+
+		int64_t time = start + offset;
+		uint16_t adc = 0;
+		uint8_t flags = 0;
+		for(int i = DATALOG_HEADER_SIZE; i < DATALOG_PAGE_SIZE;)
+		{
+			uint8_t b = page[i];
+			if(!(b & DATALOG_DELTA_MASK))
+			{
+				adc += (b & 0x40) ? (int)b - 0x80 : b;
+				++i;
+			}
+			else if((b & 0xFC) == DATALOG_FULL && i + 2 < DATALOG_PAGE_SIZE)
+			{
+				adc = ((b & 0x03) << 8) | page[i + 1];
+				flags = page[i + 2];
+				i += 3;
+			}
+			else if(b == DATALOG_GAP && i + 2 < DATALOG_PAGE_SIZE)
+			{
+				time += (uint64_t)(page[i + 1] | (page[i + 2] << 8)) * period;
+				i += 3;
+				continue;
+			}
+			else
+				break;	//end of the page
+			emit(time, adc, flags, period);
+			time += period;
+		}
+		next_time = time;
+	}
+	flush_output();
+	double seconds = (double)(clock() - started) / CLOCKS_PER_SEC;
+	free(image);
+
+	FILE *out = (mode == 's') ? stdout : stderr;
+	fprintf(out, "%llu samples in %u pages, %u power ups, %.1f h of history decoded in %.3f s\n",
+			(unsigned long long)summary.samples, summary.pages, summary.boots + (summary.pages > 0),
+			next_time / 3600000.0, seconds);
+	if(mode == 's' && summary.samples)
+		printf("battery %u-%umV mean %llumV, load on %.2f h, charging %.2f h, external power %.2f h\n",
+				summary.min_millivolts, summary.max_millivolts,
+				(unsigned long long)(summary.sum_millivolts / summary.samples), summary.load_on_time / 3600000.0,
+				summary.charge_time / 3600000.0, summary.external_time / 3600000.0);
+	return 0;
+}
+
+
+static int write_image(const char *path, uint16_t period)
+{
+	if(!flash_file_open(path, 1))
+	{
+		perror(path);
+		return 1;
+	}
+	datalog_init(period);
+
+	//the samples go through the firmware's control decisions so the load and charging flags are the ones it would log
+	struct control_policy policy;
+	struct control_state state = { 0, 0, 0, 0, 0 };
+	control_policy_init(&policy, SOC_LIMIT);
+
+	char line[128];
+	uint64_t samples = 0;
+	while(fgets(line, sizeof(line), stdin))
+	{
+		char *end;
+		unsigned long time = strtoul(line, &end, 10);
+		if(end == line || *end != ',')
+			continue;	//header or comment line
+		unsigned long millivolts = strtoul(end + 1, &end, 10);
+		uint8_t external = (*end == ',') ? strtoul(end + 1, NULL, 10) != 0 : 0;
+		uint8_t events[CONTROL_MAX_EVENTS];
+		control_step(&policy, &state, control_soc(millivolts), external, events);
+		uint8_t flags = external ? FRAME_FLAG_EXTERNAL_POWER : 0;
+		if(state.load_on)
+			flags |= FRAME_FLAG_LOAD_ON;
+		if(state.charging)
+			flags |= FRAME_FLAG_CHARGING;
+		if(state.buzzer_on)
+			flags |= FRAME_FLAG_BUZZER_ON;
+		datalog_add(time, control_adc(millivolts), flags);
+		datalog_poll();
+		++samples;
+	}
+	datalog_sync();
+	flash_file_close();
+	fprintf(stderr, "%llu samples logged, %u dropped\n", (unsigned long long)samples, datalog_dropped());
+	return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL, *write_path = NULL;
+	unsigned long period = 1000;	//DATALOG_PERIOD in defs.h
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "-s") || !strcmp(argv[i], "-b"))
+			mode = argv[i][1];
+		else if(!strcmp(argv[i], "-w") && i + 1 < argc)
+			write_path = argv[++i];
+		else if(!strcmp(argv[i], "-p") && i + 1 < argc)
+			period = strtoul(argv[++i], NULL, 10);
+		else
+			path = argv[i];
+	}
+	if(write_path && period > 0 && period <= 0xFFFF)
+		return write_image(write_path, period);
+	if(!path)
+	{
+		fprintf(stderr, "usage: %s [-s | -b] unit.img\n"
+				"       %s -w unit.img [-p period_ms] < trace.csv\n", argv[0], argv[0]);
+		return 1;
+	}
+	return read_image(path);
+}
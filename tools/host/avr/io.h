@@ -0,0 +1,21 @@
+/*
+ * io.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Host stand-in for <avr/io.h>, just enough for the host tools to
+ * build the LCD driver. The ports are plain variables.
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+static volatile uint8_t DDRD __attribute__((unused));
+static volatile uint8_t PORTD __attribute__((unused));
+static volatile uint8_t DDRB __attribute__((unused));	//LCD_EN2
+static volatile uint8_t PORTB __attribute__((unused));
+
+#endif /* HOST_AVR_IO_H_ */
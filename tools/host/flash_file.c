@@ -0,0 +1,89 @@
+/*
+ * flash_file.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+#include <stdio.h>
+#include <string.h>
+#include "flash.h"
+#include "flash_file.h"
+
+static FILE *image = NULL;
+
+
+int flash_file_open(const char *path, int create)
+{
+	/* Opens an image file, a new one is created blank (all 0xFF)
+	 * when create is set and the file doesn't exist yet. Returns
+	 * 0 on failure.
+	 */
+	image = fopen(path, "r+b");
+	if(!image && create)
+	{
+		image = fopen(path, "w+b");
+		if(!image)
+			return 0;
+		static uint8_t blank[FLASH_SECTOR_SIZE];
+		memset(blank, 0xFF, sizeof(blank));
+		for(unsigned long i = 0; i < FLASH_SIZE / FLASH_SECTOR_SIZE; ++i)
+			fwrite(blank, 1, sizeof(blank), image);
+	}
+	return image != NULL;
+}
+
+
+void flash_file_close(void)
+{
+	if(image)
+		fclose(image);
+	image = NULL;
+}
+
+
+void flash_init(void)
+{
+}
+
+
+uint8_t flash_busy(void)
+{
+	return 0;
+}
+
+
+uint8_t flash_program(uint32_t address, const uint8_t *data, uint16_t length)
+{
+	uint8_t page[FLASH_PAGE_SIZE];
+	if(address % FLASH_SECTOR_SIZE == 0)
+	{
+		uint8_t blank[FLASH_SECTOR_SIZE];
+		memset(blank, 0xFF, sizeof(blank));
+		fseek(image, address, SEEK_SET);
+		fwrite(blank, 1, sizeof(blank), image);
+	}
+	if(length > FLASH_PAGE_SIZE - address % FLASH_PAGE_SIZE)
+		length = FLASH_PAGE_SIZE - address % FLASH_PAGE_SIZE;	//the flash wraps around within the page, don't bother
+	fseek(image, address, SEEK_SET);
+	if(fread(page, 1, length, image) != length)
+		return 0;
+	for(uint16_t i = 0; i < length; ++i)
+		page[i] &= data[i];
+	fseek(image, address, SEEK_SET);
+	fwrite(page, 1, length, image);
+	return 1;
+}
+
+
+void flash_poll(void)
+{
+}
+
+
+uint8_t flash_read(uint32_t address, void *data, uint16_t length)
+{
+	fseek(image, address, SEEK_SET);
+	if(fread(data, 1, length, image) != length)
+		memset(data, 0xFF, length);
+	return 1;
+}
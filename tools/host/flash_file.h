@@ -0,0 +1,19 @@
+/*
+ * flash_file.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ */
+
+#ifndef FLASH_FILE_H_
+#define FLASH_FILE_H_
+
+/* Host stand-in for src/flash.c, the flash contents are kept in an
+ * image file of FLASH_SIZE bytes. Writes complete right away and
+ * follow the rules of NOR flash: a program only clears bits and a
+ * write to the start of a sector erases it to 0xFF first.
+ */
+int flash_file_open(const char *path, int create);
+void flash_file_close(void);
+
+#endif /* FLASH_FILE_H_ */
@@ -0,0 +1,24 @@
+/*
+ * delay.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Host stand-in for <util/delay.h>. The busy waits return at once,
+ * the LCD driver accounts for them in lcd_bus_stats instead.
+ */
+
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+static inline void _delay_ms(double ms)
+{
+	(void)ms;
+}
+
+static inline void _delay_us(double us)
+{
+	(void)us;
+}
+
+#endif /* HOST_UTIL_DELAY_H_ */
@@ -0,0 +1,230 @@
+/*
+ * modbus_sim.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Host side Modbus RTU test bench. The slave role runs the firmware's
+ * Modbus core (src/modbus.c) against a simulated unit on a pty, the
+ * master role polls a slave the same way a supervisor on the RS-485 bus
+ * would.
+ *
+ * Build:
+ *   cc -O2 -Wall -I src -o modbus_sim tools/modbus_sim.c src/modbus.c src/crc.c
+ *
+ * Usage:
+ *   modbus_sim -p [address]                      simulated slave on a new pty, prints its name
+ *   modbus_sim <port> read <slave> <reg> <count>  read holding registers
+ *   modbus_sim <port> write <slave> <reg> <value> write a single register
+ */
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "modbus.h"
+#include "crc.h"
+#include "frame.h"
+
+#define FRAME_GAP 5	//silence that ends a frame on the host, a bit longer than t3.5 to absorb scheduling jitter (unit = ms)
+#define RESPONSE_TIMEOUT 500	//time the master waits for a response (unit = ms)
+
+//state of the simulated unit
+static uint16_t sim_millivolts = 12000;
+static uint16_t sim_soc_limit = 50;
+static uint16_t sim_cutoffs = 0;
+
+
+uint8_t modbus_read_register(uint16_t address, uint16_t *value)
+{
+	uint8_t soc = (uint32_t)sim_millivolts * 100 / 12000;
+	switch(address)
+	{
+		case MODBUS_REG_SOC: *value = soc; break;
+		case MODBUS_REG_MILLIVOLTS: *value = sim_millivolts; break;
+		case MODBUS_REG_STATUS: *value = soc >= sim_soc_limit ? FRAME_FLAG_LOAD_ON : 0; break;
+		case MODBUS_REG_SOC_LIMIT: *value = sim_soc_limit; break;
+		case MODBUS_REG_CUTOFFS: *value = sim_cutoffs; break;
+		case MODBUS_REG_ADDRESS: *value = modbus_address(); break;
+		default: {
+			if(address >= MODBUS_REGISTER_COUNT)
+				return MODBUS_ILLEGAL_ADDRESS;
+			*value = 0;
+		}
+	}
+	return MODBUS_OK;
+}
+
+
+uint8_t modbus_write_register(uint16_t address, uint16_t value)
+{
+	switch(address)
+	{
+		case MODBUS_REG_SOC_LIMIT: {
+			if(value == 0 || value > 99)
+				return MODBUS_ILLEGAL_VALUE;
+			sim_soc_limit = value;
+			return MODBUS_OK;
+		}
+		case MODBUS_REG_ADDRESS: {
+			if(value == MODBUS_BROADCAST || value > 247)
+				return MODBUS_ILLEGAL_VALUE;
+			modbus_set_address(value);
+			return MODBUS_OK;
+		}
+	}
+	return MODBUS_ILLEGAL_ADDRESS;
+}
+
+
+static void make_raw(int fd)
+{
+	struct termios tio;
+	if(tcgetattr(fd, &tio) < 0)
+		return;
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, B19200);
+	cfsetospeed(&tio, B19200);
+	tcsetattr(fd, TCSANOW, &tio);
+}
+
+
+static int read_frame(int fd, uint8_t *frame, int first_timeout)
+{
+	/* Collects bytes until the line has been silent for
+	 * FRAME_GAP, the host equivalent of the t3.5 timer.
+	 */
+	int length = 0;
+	int timeout = first_timeout;
+	for(;;)
+	{
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		int ready = poll(&pfd, 1, timeout);
+		if(ready < 0 && errno == EINTR)
+			continue;
+		if(ready <= 0)
+			return length;
+		ssize_t n = read(fd, frame + length, MODBUS_MAX_FRAME - length);
+		if(n < 0 && errno == EIO)
+		{
+			//a pty master returns EIO while nothing has the slave open
+			usleep(10000);
+			continue;
+		}
+		if(n <= 0)
+			return length;
+		length += n;
+		if(length == MODBUS_MAX_FRAME)
+			return length;
+		timeout = FRAME_GAP;
+	}
+}
+
+
+static int run_slave(uint8_t address)
+{
+	int fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if(fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0)
+	{
+		perror("posix_openpt");
+		return 1;
+	}
+	make_raw(fd);
+	printf("%s\n", ptsname(fd));
+	fflush(stdout);
+
+	modbus_init(address);
+	uint8_t request[MODBUS_MAX_FRAME], response[MODBUS_MAX_FRAME];
+	for(;;)
+	{
+		int length = read_frame(fd, request, -1);
+		if(!length)
+			continue;
+		uint8_t response_length = modbus_process(request, length, response);
+		if(response_length && write(fd, response, response_length) < 0)
+			perror("write");
+
+		//let the simulated battery discharge a little with every request
+		if(sim_millivolts > 5000)
+			sim_millivolts -= 10;
+		if(sim_millivolts * 100 / 12000 == sim_soc_limit - 1)
+			++sim_cutoffs;
+	}
+}
+
+
+static int transact(int fd, uint8_t *request, int length)
+{
+	uint16_t crc = crc16(request, length);
+	request[length++] = crc;
+	request[length++] = crc >> 8;
+	if(write(fd, request, length) != length)
+	{
+		perror("write");
+		return 1;
+	}
+
+	uint8_t response[MODBUS_MAX_FRAME];
+	int response_length = read_frame(fd, response, RESPONSE_TIMEOUT);
+	if(response_length == 0)
+	{
+		fprintf(stderr, "timeout\n");
+		return 1;
+	}
+	if(response_length < 5 || crc16(response, response_length) != 0)
+	{
+		fprintf(stderr, "corrupted response (%d bytes)\n", response_length);
+		return 1;
+	}
+	if(response[1] & 0x80)
+	{
+		fprintf(stderr, "exception 0x%02x\n", response[2]);
+		return 1;
+	}
+
+	if(response[1] == MODBUS_READ_HOLDING_REGISTERS)
+	{
+		uint16_t start = (request[2] << 8) | request[3];
+		for(int i = 0; i < response[2] / 2; ++i)
+			printf("%u: %u\n", start + i, (response[3 + i * 2] << 8) | response[4 + i * 2]);
+	}
+	else
+		printf("ok\n");
+	return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	if(argc >= 2 && !strcmp(argv[1], "-p"))
+		return run_slave(argc > 2 ? atoi(argv[2]) : 1);
+	if(argc != 6 || (strcmp(argv[2], "read") && strcmp(argv[2], "write")))
+	{
+		fprintf(stderr, "usage: %s -p [address] | <port> read <slave> <reg> <count> | <port> write <slave> <reg> <value>\n",
+				argv[0]);
+		return 1;
+	}
+
+	int fd = open(argv[1], O_RDWR | O_NOCTTY);
+	if(fd < 0)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	make_raw(fd);
+
+	uint8_t request[MODBUS_MAX_FRAME];
+	uint16_t reg = atoi(argv[4]), value = atoi(argv[5]);
+	request[0] = atoi(argv[3]);
+	request[1] = strcmp(argv[2], "read") ? MODBUS_WRITE_SINGLE_REGISTER : MODBUS_READ_HOLDING_REGISTERS;
+	request[2] = reg >> 8;
+	request[3] = reg;
+	request[4] = value >> 8;
+	request[5] = value;
+	return transact(fd, request, 6);
+}
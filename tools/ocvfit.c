@@ -0,0 +1,683 @@
+/*
+ * ocvfit.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Fits the open circuit voltage (OCV) curve of a battery chemistry to
+ * logged field data, recommends the SOC thresholds of the control
+ * policy for it and writes the OCV table of control_soc
+ * (src/soc_table.h).
+ *
+ * Build:
+ *   cc -O2 -Wall -pthread -o ocvfit tools/ocvfit.c -lm
+ *
+ * Usage:
+ *   ocvfit [-t threads] [-C capacity_mah] [-o soc_table.h] [-e chemistry] [-c chemistry] log ...
+ *   ocvfit -g samples [-s seed] > field.bin
+ *
+ * A log is either a CSV file of "millivolts,current_ma,delivered_mas"
+ * lines or, when its name ends in .bin, 8 byte little endian records
+ * of a uint16 voltage (unit = mV), an int16 current (unit = mA,
+ * positive while discharging) and a uint32 charge delivered since the
+ * battery was last full (unit = mAs). Every -c starts the group of logs
+ * of a chemistry, the logs before the first -c are "default". The
+ * capacity of a log is the most charge delivered in it unless -C sets
+ * one.
+ *
+ * The logs are mapped into memory and cut into chunks that the threads
+ * take in turn from a shared counter, so the load stays even however
+ * the logs differ in size. Each thread adds its samples up per 1% of
+ * SOC bin and per chemistry on its own, the bins are merged at the end.
+ * Under load the battery voltage sags by the current times the internal
+ * resistance: the resistance is the slope of the voltage against the
+ * current within the bins, the OCV of a bin its mean voltage with the
+ * sag added back. The curve is then made monotonic and sampled every
+ * SOC_TABLE_STEP %.
+ *
+ * The thresholds come from the knees of the curve, where its slope
+ * grows past twice the median slope: the SOC limit is kept 5% above
+ * the lower knee, where the voltage starts to drop quickly, and the
+ * charger stops at the upper knee. They are printed as a -l option of
+ * fleet so a policy can be tried on the simulated fleet straight away.
+ * -o writes the table of the chemistry named by -e (the first one by
+ * default) for a firmware build. -g writes a synthetic binary log of
+ * a known curve to try the tool on.
+ */
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 256
+#define MAX_CHEMISTRIES 16
+#define BINS 101	//SOC 0% to 100%
+#define CHUNK_SIZE (4 << 20)	//bytes a thread takes at a time
+#define RECORD_LENGTH 8	//binary log record
+#define SOC_TABLE_STEP 10	//SOC_TABLE_STEP in soc_table.h
+#define SOC_TABLE_POINTS 11
+#define KNEE_SLOPE 2.0	//a knee is where the slope grows past this multiple of the median slope
+#define LIMIT_MARGIN 5	//the SOC limit above the lower knee (unit = %)
+#define BUZZER_MARGIN 5	//the buzzer below the SOC limit
+#define CHARGE_BAND 5	//charging starts this far below the stop SOC
+
+struct bin
+{
+	//sums of the samples of a bin, current in A and voltage in mV
+	double n;
+	double i;
+	double v;
+	double ii;
+	double iv;
+};
+
+struct chemistry
+{
+	const char *name;
+	struct bin bins[BINS];
+	double ocv[BINS];	//unit = mV
+	double resistance;	//unit = mOhm
+	double capacity;	//sum over the logs, unit = mAs
+	int logs;
+};
+
+struct log
+{
+	const char *path;
+	int chemistry;
+	int binary;
+	const uint8_t *data;
+	size_t size;
+	uint32_t capacity;	//unit = mAs
+};
+
+struct chunk
+{
+	int log;
+	size_t begin;
+	size_t end;
+	uint32_t max_delivered;	//found by the first pass
+};
+
+struct job
+{
+	struct log *logs;
+	struct chunk *chunks;
+	int chunk_count;
+	int chemistry_count;
+	int pass;
+	int next_chunk;	//taken with an atomic add
+};
+
+struct worker
+{
+	struct job *job;
+	struct bin (*bins)[BINS];	//per chemistry
+	uint64_t samples;
+	uint64_t rejected;
+};
+
+
+static uint32_t get_u32(const uint8_t *p)
+{
+	return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+static const uint8_t* parse_line(const uint8_t *p, const uint8_t *end, int32_t fields[3], int *valid)
+{
+	//"millivolts,current_ma,delivered_mas", returns the start of the next line
+	int field = 0, negative = 0, digits = 0;
+	int32_t value = 0;
+	*valid = 0;
+	for(; p < end && *p != '\n'; ++p)
+	{
+		uint8_t c = *p;
+		if(c >= '0' && c <= '9')
+		{
+			value = value * 10 + (c - '0');
+			++digits;
+		}
+		else if(c == '-' && !digits)
+			negative = 1;
+		else if(c == ',' && digits && field < 2)
+		{
+			fields[field++] = negative ? -value : value;
+			value = negative = digits = 0;
+		}
+		else if(c != '\r')
+			field = 3;	//header, comment or a broken line
+	}
+	if(field == 2 && digits)
+	{
+		fields[2] = negative ? -value : value;
+		*valid = 1;
+	}
+	return p + 1;
+}
+
+
+static void add_sample(struct worker *worker, const struct log *log, int32_t millivolts, int32_t current,
+		uint32_t delivered)
+{
+	if(!log->capacity || millivolts <= 0 || millivolts > 0xFFFF)
+	{
+		++worker->rejected;
+		return;
+	}
+	double soc = 100.0 * (1.0 - (double)delivered / log->capacity);
+	int b = (soc <= 0) ? 0 : (int)(soc + 0.5);
+	struct bin *bin = &worker->bins[log->chemistry][b > 100 ? 100 : b];
+	double amps = current / 1000.0;
+	bin->n += 1;
+	bin->i += amps;
+	bin->v += millivolts;
+	bin->ii += amps * amps;
+	bin->iv += amps * millivolts;
+	++worker->samples;
+	return;
+}
+
+
+static void process_chunk(struct worker *worker, struct chunk *chunk)
+{
+	//the first pass only finds the charge delivered at most, the second one bins the samples
+	const struct log *log = &worker->job->logs[chunk->log];
+	int pass = worker->job->pass;
+	uint32_t max_delivered = 0;
+	if(log->binary)
+	{
+		for(const uint8_t *r = log->data + chunk->begin; r + RECORD_LENGTH <= log->data + chunk->end;
+				r += RECORD_LENGTH)
+		{
+			uint32_t delivered = get_u32(r + 4);
+			if(pass == 1)
+			{
+				if(delivered > max_delivered)
+					max_delivered = delivered;
+			}
+			else
+				add_sample(worker, log, r[0] | (r[1] << 8), (int16_t)(r[2] | (r[3] << 8)), delivered);
+		}
+	}
+	else
+	{
+		//a chunk owns the lines that start in it
+		const uint8_t *p = log->data + chunk->begin, *end = log->data + log->size;
+		if(chunk->begin)
+			while(p < end && p[-1] != '\n')
+				++p;
+		while(p < log->data + chunk->end)
+		{
+			int32_t fields[3];
+			int valid;
+			p = parse_line(p, end, fields, &valid);
+			if(!valid)
+				continue;
+			if(pass == 1)
+			{
+				if((uint32_t)fields[2] > max_delivered)
+					max_delivered = fields[2];
+			}
+			else
+				add_sample(worker, log, fields[0], fields[1], fields[2]);
+		}
+	}
+	chunk->max_delivered = max_delivered;
+	return;
+}
+
+
+static void* work(void *argument)
+{
+	struct worker *worker = argument;
+	struct job *job = worker->job;
+	for(;;)
+	{
+		int c = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED);
+		if(c >= job->chunk_count)
+			break;
+		process_chunk(worker, &job->chunks[c]);
+	}
+	return NULL;
+}
+
+
+static void run_pass(struct job *job, struct worker *workers, int threads)
+{
+	pthread_t ids[MAX_THREADS];
+	job->next_chunk = 0;
+	for(int t = 0; t < threads; ++t)
+		pthread_create(&ids[t], NULL, work, &workers[t]);
+	for(int t = 0; t < threads; ++t)
+		pthread_join(ids[t], NULL);
+	return;
+}
+
+
+static void fit(struct chemistry *c)
+{
+	/* The resistance is pooled over all of the bins: within a bin the
+	 * SOC hardly moves, so what the voltage does with the current is
+	 * the sag across the internal resistance.
+	 */
+	double sxy = 0, sxx = 0;
+	for(int b = 0; b < BINS; ++b)
+	{
+		const struct bin *bin = &c->bins[b];
+		if(bin->n < 2)
+			continue;
+		sxy += bin->iv - bin->i * bin->v / bin->n;
+		sxx += bin->ii - bin->i * bin->i / bin->n;
+	}
+	c->resistance = (sxx > 1e-9) ? -sxy / sxx : 0;
+	if(c->resistance < 0)
+		c->resistance = 0;
+
+	//OCV of every bin with samples, weighted pool adjacent violators keep the curve rising
+	double value[BINS], weight[BINS];
+	int first[BINS], blocks = 0;
+	for(int b = 0; b < BINS; ++b)
+	{
+		const struct bin *bin = &c->bins[b];
+		if(bin->n < 1)
+			continue;
+		value[blocks] = (bin->v + c->resistance * bin->i) / bin->n;
+		weight[blocks] = bin->n;
+		first[blocks++] = b;
+		while(blocks > 1 && value[blocks - 2] > value[blocks - 1])
+		{
+			double w = weight[blocks - 2] + weight[blocks - 1];
+			value[blocks - 2] = (value[blocks - 2] * weight[blocks - 2] + value[blocks - 1] * weight[blocks - 1]) / w;
+			weight[blocks - 2] = w;
+			--blocks;
+		}
+	}
+	for(int b = 0; b < BINS; ++b)
+		c->ocv[b] = -1;
+	for(int k = 0; k < blocks; ++k)
+		for(int b = first[k]; b < (k + 1 < blocks ? first[k + 1] : BINS); ++b)
+			c->ocv[b] = c->bins[b].n >= 1 ? value[k] : -1;
+
+	//bins without samples are interpolated, the ends held at the nearest bin with samples
+	int last = -1;
+	for(int b = 0; b < BINS; ++b)
+	{
+		if(c->ocv[b] < 0)
+			continue;
+		if(last < 0)
+			for(int e = 0; e < b; ++e)
+				c->ocv[e] = c->ocv[b];
+		else
+			for(int e = last + 1; e < b; ++e)
+				c->ocv[e] = c->ocv[last] + (c->ocv[b] - c->ocv[last]) * (e - last) / (b - last);
+		last = b;
+	}
+	for(int e = last + 1; e < BINS && last >= 0; ++e)
+		c->ocv[e] = c->ocv[last];
+	return;
+}
+
+
+static void make_table(const struct chemistry *c, uint16_t table[SOC_TABLE_POINTS])
+{
+	//control_soc divides by the step between two points, so the table has to rise strictly
+	for(int p = 0; p < SOC_TABLE_POINTS; ++p)
+	{
+		double millivolts = c->ocv[p * SOC_TABLE_STEP] + 0.5;
+		table[p] = millivolts < 0 ? 0 : millivolts > 0xFFFF ? 0xFFFF : millivolts;
+		if(p && table[p] <= table[p - 1])
+			table[p] = table[p - 1] + 1;
+	}
+	return;
+}
+
+
+static int by_value(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+
+static void recommend(const struct chemistry *c, int *limit, int *buzzer, int *start, int *stop, int *low_knee,
+		int *high_knee)
+{
+	double slope[BINS - 1], sorted[BINS - 1];
+	for(int b = 0; b < BINS - 1; ++b)
+		sorted[b] = slope[b] = c->ocv[b + 1] - c->ocv[b];
+	qsort(sorted + 10, 80, sizeof(double), by_value);	//the median of the flat middle of the curve
+	double threshold = KNEE_SLOPE * sorted[50];
+
+	*low_knee = 0;
+	for(int b = 50; b > 0; --b)
+		if(slope[b - 1] > threshold)
+		{
+			*low_knee = b;
+			break;
+		}
+	*high_knee = 100;
+	for(int b = 50; b < BINS - 1; ++b)
+		if(slope[b] > threshold)
+		{
+			*high_knee = b;
+			break;
+		}
+
+	//rounded to 5% steps, the way the thresholds are set on the unit
+	*limit = (*low_knee + LIMIT_MARGIN + 4) / 5 * 5;
+	if(*limit < 10)
+		*limit = 10;
+	if(*limit > 80)
+		*limit = 80;
+	*buzzer = *limit - BUZZER_MARGIN;
+	*stop = *high_knee / 5 * 5;
+	if(*stop > 95)
+		*stop = 95;
+	if(*stop < *limit + 2 * CHARGE_BAND)
+		*stop = *limit + 2 * CHARGE_BAND;
+	*start = *stop - CHARGE_BAND;
+	return;
+}
+
+
+static void report(const struct chemistry *c)
+{
+	uint64_t samples = 0;
+	for(int b = 0; b < BINS; ++b)
+		samples += c->bins[b].n;
+	printf("\n%s: %llu samples in %d logs, capacity %.1f Ah, internal resistance %.1f mOhm\n", c->name,
+			(unsigned long long)samples, c->logs, c->logs ? c->capacity / c->logs / 3.6e6 : 0, c->resistance);
+	if(!samples)
+		return;
+	uint16_t table[SOC_TABLE_POINTS];
+	make_table(c, table);
+	printf("%6s %8s %10s\n", "soc %", "ocv mV", "samples");
+	for(int p = 0; p < SOC_TABLE_POINTS; ++p)
+		printf("%6d %8u %10.0f\n", p * SOC_TABLE_STEP, table[p], c->bins[p * SOC_TABLE_STEP].n);
+	int limit, buzzer, start, stop, low_knee, high_knee;
+	recommend(c, &limit, &buzzer, &start, &stop, &low_knee, &high_knee);
+	printf("knees at %d%% and %d%%: SOC limit %d%%, buzzer %d%%, charging %d%%-%d%% (fleet -l %d,%d,%d,%d,0)\n",
+			low_knee, high_knee, limit, buzzer, start, stop, limit, buzzer, start, stop);
+	return;
+}
+
+
+static int write_table(const char *path, const struct chemistry *c)
+{
+	FILE *file = fopen(path, "w");
+	if(!file)
+	{
+		perror(path);
+		return 1;
+	}
+	uint16_t table[SOC_TABLE_POINTS];
+	make_table(c, table);
+	fprintf(file, "/*\n * soc_table.h\n *\n *  Created on: Oct 18, 2026\n *      Author: kosmaz\n *\n"
+			" * Open circuit voltage of the battery at every SOC_TABLE_STEP %% of\n"
+			" * SOC, from 0%% to 100%%, used by control_soc (unit = mV). Written by\n"
+			" * tools/ocvfit from the field logs of the %s chemistry.\n */\n\n"
+			"#ifndef SOC_TABLE_H_\n#define SOC_TABLE_H_\n\n"
+			"#define SOC_TABLE_STEP %d\n#define SOC_TABLE_POINTS %d\n#define SOC_TABLE_MILLIVOLTS {",
+			c->name, SOC_TABLE_STEP, SOC_TABLE_POINTS);
+	for(int p = 0; p < SOC_TABLE_POINTS; ++p)
+		fprintf(file, "%s %u", p ? "," : "", table[p]);
+	fprintf(file, " }\n\n#endif /* SOC_TABLE_H_ */\n");
+	fclose(file);
+	return 0;
+}
+
+
+static double model_ocv(double soc)
+{
+	//a flat middle between a steep drop below 15% and a rise above 90%, within the 0-12V of the ADC
+	return 9000 + 24 * soc - 1500 * exp(-soc / 6) + 600 * exp((soc - 100) / 4);
+}
+
+
+static int generate(uint64_t samples, uint32_t seed)
+{
+	/* Full discharges of a 100Ah battery with 50mOhm of internal
+	 * resistance, sampled every second under a load that changes every
+	 * few minutes, with some noise on the voltage.
+	 */
+	const double capacity = 100 * 3.6e6, resistance = 50;
+	uint32_t state = seed * 2654435761u + 1;
+	uint8_t buffer[RECORD_LENGTH * 4096];
+	size_t length = 0;
+	double delivered = 0;
+	int current = 0, hold = 0;
+	for(uint64_t n = 0; n < samples; ++n)
+	{
+		if(!hold--)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			current = 500 + state % 15000;
+			hold = 60 + (state >> 16) % 600;
+		}
+		if(delivered >= capacity)
+			delivered = 0;	//charged up again
+		double soc = 100 * (1 - delivered / capacity);
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		int millivolts = model_ocv(soc) - resistance * current / 1000 + (int)(state % 41) - 20;
+		uint32_t charge = delivered;
+		uint8_t *r = buffer + length;
+		r[0] = millivolts;
+		r[1] = millivolts >> 8;
+		r[2] = current;
+		r[3] = current >> 8;
+		r[4] = charge;
+		r[5] = charge >> 8;
+		r[6] = charge >> 16;
+		r[7] = charge >> 24;
+		length += RECORD_LENGTH;
+		if(length == sizeof(buffer))
+		{
+			fwrite(buffer, 1, length, stdout);
+			length = 0;
+		}
+		delivered += current;
+	}
+	fwrite(buffer, 1, length, stdout);
+	fprintf(stderr, "model OCV:");
+	for(int p = 0; p < SOC_TABLE_POINTS; ++p)
+		fprintf(stderr, " %.0f", model_ocv(p * SOC_TABLE_STEP));
+	fprintf(stderr, " mV, %.0f mOhm\n", resistance);
+	return 0;
+}
+
+
+static int map_log(struct log *log)
+{
+	int fd = open(log->path, O_RDONLY);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st))
+	{
+		perror(log->path);
+		return 0;
+	}
+	log->size = st.st_size;
+	log->data = NULL;
+	if(log->size)
+	{
+		void *data = mmap(NULL, log->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(data == MAP_FAILED)
+		{
+			perror(log->path);
+			close(fd);
+			return 0;
+		}
+		madvise(data, log->size, MADV_SEQUENTIAL);
+		log->data = data;
+	}
+	close(fd);
+	size_t length = strlen(log->path);
+	log->binary = length > 4 && !strcmp(log->path + length - 4, ".bin");
+	return 1;
+}
+
+
+int main(int argc, char **argv)
+{
+	static struct chemistry chemistries[MAX_CHEMISTRIES];
+	struct log *logs = malloc(argc * sizeof(struct log));
+	int log_count = 0, chemistry_count = 0, current = -1;
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	const char *output = NULL, *export = NULL;
+	unsigned long long generate_samples = 0;
+	uint32_t capacity = 0, seed = 1;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "-t") && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-C") && i + 1 < argc)
+			capacity = strtoul(argv[++i], NULL, 10) * 3600UL;
+		else if(!strcmp(argv[i], "-o") && i + 1 < argc)
+			output = argv[++i];
+		else if(!strcmp(argv[i], "-e") && i + 1 < argc)
+			export = argv[++i];
+		else if(!strcmp(argv[i], "-g") && i + 1 < argc)
+			generate_samples = strtoull(argv[++i], NULL, 10);
+		else if(!strcmp(argv[i], "-s") && i + 1 < argc)
+			seed = strtoul(argv[++i], NULL, 10);
+		else if(!strcmp(argv[i], "-c") && i + 1 < argc && chemistry_count < MAX_CHEMISTRIES)
+		{
+			current = chemistry_count;
+			chemistries[chemistry_count++].name = argv[++i];
+		}
+		else if(argv[i][0] != '-')
+		{
+			if(current < 0)
+			{
+				current = chemistry_count;
+				chemistries[chemistry_count++].name = "default";
+			}
+			logs[log_count].path = argv[i];
+			logs[log_count++].chemistry = current;
+		}
+		else
+			log_count = -1;
+		if(log_count < 0)
+			break;
+	}
+	if(generate_samples)
+		return generate(generate_samples, seed);
+	if(log_count < 1)
+	{
+		fprintf(stderr, "usage: %s [-t threads] [-C capacity_mah] [-o soc_table.h] [-e chemistry] [-c chemistry] log ...\n"
+				"       %s -g samples [-s seed] > field.bin\n", argv[0], argv[0]);
+		return 1;
+	}
+	if(threads < 1)
+		threads = 1;
+	if(threads > MAX_THREADS)
+		threads = MAX_THREADS;
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	size_t bytes = 0;
+	int chunk_count = 0;
+	for(int l = 0; l < log_count; ++l)
+	{
+		if(!map_log(&logs[l]))
+			return 1;
+		bytes += logs[l].size;
+		chunk_count += (logs[l].size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	}
+	struct chunk *chunks = malloc((chunk_count + 1) * sizeof(struct chunk));
+	chunk_count = 0;
+	for(int l = 0; l < log_count; ++l)
+		for(size_t begin = 0; begin < logs[l].size; begin += CHUNK_SIZE)
+		{
+			//CHUNK_SIZE is a multiple of RECORD_LENGTH, the binary records never straddle two chunks
+			chunks[chunk_count].log = l;
+			chunks[chunk_count].begin = begin;
+			chunks[chunk_count++].end = (begin + CHUNK_SIZE < logs[l].size) ? begin + CHUNK_SIZE : logs[l].size;
+		}
+
+	struct job job = { logs, chunks, chunk_count, chemistry_count, 1, 0 };
+	struct worker *workers = calloc(threads, sizeof(struct worker));
+	for(int t = 0; t < threads; ++t)
+	{
+		workers[t].job = &job;
+		workers[t].bins = calloc(chemistry_count, sizeof(*workers[t].bins));
+	}
+	if(!capacity)
+	{
+		run_pass(&job, workers, threads);
+		for(int c = 0; c < chunk_count; ++c)
+			if(chunks[c].max_delivered > logs[chunks[c].log].capacity)
+				logs[chunks[c].log].capacity = chunks[c].max_delivered;
+	}
+	else
+		for(int l = 0; l < log_count; ++l)
+			logs[l].capacity = capacity;
+	for(int l = 0; l < log_count; ++l)
+	{
+		chemistries[logs[l].chemistry].capacity += logs[l].capacity;
+		++chemistries[logs[l].chemistry].logs;
+	}
+
+	job.pass = 2;
+	run_pass(&job, workers, threads);
+	uint64_t samples = 0, rejected = 0;
+	for(int t = 0; t < threads; ++t)
+	{
+		samples += workers[t].samples;
+		rejected += workers[t].rejected;
+		for(int c = 0; c < chemistry_count; ++c)
+			for(int b = 0; b < BINS; ++b)
+			{
+				struct bin *to = &chemistries[c].bins[b], *from = &workers[t].bins[c][b];
+				to->n += from->n;
+				to->i += from->i;
+				to->v += from->v;
+				to->ii += from->ii;
+				to->iv += from->iv;
+			}
+		free(workers[t].bins);
+	}
+	for(int c = 0; c < chemistry_count; ++c)
+		fit(&chemistries[c]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("%llu samples (%llu rejected, %.1f MB) of %d logs in %.3f s on %d threads (%.1fM samples/s)\n",
+			(unsigned long long)samples, (unsigned long long)rejected, bytes / 1e6, log_count, seconds, threads,
+			samples / seconds / 1e6);
+	for(int c = 0; c < chemistry_count; ++c)
+		report(&chemistries[c]);
+
+	int status = 0;
+	if(output)
+	{
+		int c = 0;
+		while(export && c < chemistry_count && strcmp(chemistries[c].name, export))
+			++c;
+		if(c == chemistry_count)
+		{
+			fprintf(stderr, "no chemistry %s\n", export);
+			status = 1;
+		}
+		else
+			status = write_table(output, &chemistries[c]);
+	}
+	for(int l = 0; l < log_count; ++l)
+		if(logs[l].data)
+			munmap((void *)logs[l].data, logs[l].size);
+	free(chunks);
+	free(workers);
+	free(logs);
+	return status;
+}
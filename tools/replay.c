@@ -0,0 +1,264 @@
+/*
+ * replay.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Replays recorded or synthetic battery traces through the firmware's
+ * control decisions (src/control.c) on a virtual clock and prints the
+ * load, buzzer and charger transitions of one or more policies.
+ *
+ * Build:
+ *   cc -O2 -Wall -I src -o replay tools/replay.c src/control.c
+ *
+ * Usage:
+ *   replay [-a] [-q] [-l limit[,buzzer,charge_start,charge_stop,hysteresis]] ... trace.csv|trace.bin|-
+ *   replay -g hours [-b] > trace
+ *
+ * A CSV trace has a "time_ms,millivolts[,external_power]" line per
+ * sample, -a reads raw 10 bit ADC readings instead of millivolts. A
+ * .bin trace (or -b) is made of 8 byte little endian records:
+ * uint32 time_ms, uint16 millivolts, uint8 external_power, uint8 0.
+ * Every -l adds a policy, all of them are run side by side in a single
+ * pass over the trace. -q only prints the summary of every policy.
+ * -g writes a synthetic trace of the given length with a sample every
+ * second: a load discharging the battery and a charger that is
+ * available during the day.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "control.h"
+#include "events.h"
+
+#define MAX_POLICIES 16
+#define DEFAULT_SOC_LIMIT 50	//DEFAULT_SOC_VALUE in defs.h
+#define RECORD_LENGTH 8
+
+struct sample
+{
+	uint32_t time;	//unit = ms
+	uint16_t millivolts;
+	uint8_t external_power;
+};
+
+struct run
+{
+	struct control_policy policy;
+	struct control_state state;
+	uint64_t load_on_time;	//unit = ms
+	uint64_t buzzer_time;
+	uint64_t charge_time;
+	uint32_t cutoffs;
+	uint32_t charge_cycles;
+	uint32_t transitions;
+};
+
+static struct run runs[MAX_POLICIES];
+static int run_count = 0;
+
+
+static const char* event_name(uint8_t code)
+{
+	switch(code)
+	{
+		case EVENT_LOAD_ON: return "LOAD_ON";
+		case EVENT_LOAD_OFF: return "LOAD_OFF";
+		case EVENT_CHARGE_ON: return "CHARGE_ON";
+		case EVENT_CHARGE_OFF: return "CHARGE_OFF";
+		case EVENT_BUZZER_ON: return "BUZZER_ON";
+		case EVENT_BUZZER_OFF: return "BUZZER_OFF";
+	}
+	return "UNKNOWN";
+}
+
+
+static int read_sample(FILE *file, int binary, int adc, struct sample *sample)
+{
+	if(binary)
+	{
+		uint8_t record[RECORD_LENGTH];
+		if(fread(record, 1, RECORD_LENGTH, file) != RECORD_LENGTH)
+			return 0;
+		sample->time = record[0] | (record[1] << 8) | (record[2] << 16) | ((uint32_t)record[3] << 24);
+		sample->millivolts = record[4] | (record[5] << 8);
+		sample->external_power = record[6];
+		return 1;
+	}
+
+	char line[128];
+	while(fgets(line, sizeof(line), file))
+	{
+		char *p = line, *end;
+		unsigned long time = strtoul(p, &end, 10);
+		if(end == p || *end != ',')
+			continue;	//header or comment line
+		p = end + 1;
+		unsigned long value = strtoul(p, &end, 10);
+		if(end == p)
+			continue;
+		sample->time = time;
+		sample->millivolts = adc ? control_millivolts(value) : value;
+		sample->external_power = (*end == ',') ? strtoul(end + 1, NULL, 10) != 0 : 0;
+		return 1;
+	}
+	return 0;
+}
+
+
+static void generate(double hours, int binary)
+{
+	/* A 100Ah battery feeding a 5A load around the clock and a
+	 * 20A charger that is available from 08:00 to 17:00. The
+	 * voltage follows the SOC with some ADC noise.
+	 */
+	double soc = 80.0;
+	uint32_t samples = hours * 3600;
+	srand(1);
+	if(!binary)
+		printf("time_ms,millivolts,external_power\n");
+	for(uint32_t i = 0; i < samples; ++i)
+	{
+		uint32_t time = i * 1000u;
+		uint32_t hour = (time / 3600000u) % 24;
+		uint8_t external = hour >= 8 && hour < 17;
+		soc += (external ? 15.0 : -5.0) / 100.0 / 3600.0 * 100.0;
+		if(soc > 100.0)
+			soc = 100.0;
+		if(soc < 20.0)
+			soc = 20.0;
+		uint16_t millivolts = soc * CONTROL_MAX_MILLIVOLTS / 100.0 + (rand() % 41) - 20;
+
+		if(binary)
+		{
+			uint8_t record[RECORD_LENGTH] = { time, time >> 8, time >> 16, time >> 24,
+					millivolts, millivolts >> 8, external, 0 };
+			fwrite(record, 1, RECORD_LENGTH, stdout);
+		}
+		else
+			printf("%u,%u,%u\n", time, millivolts, external);
+	}
+}
+
+
+static void add_policy(const char *spec)
+{
+	if(run_count == MAX_POLICIES)
+	{
+		fprintf(stderr, "at most %d policies\n", MAX_POLICIES);
+		exit(1);
+	}
+	struct run *run = &runs[run_count++];
+	unsigned limit = DEFAULT_SOC_LIMIT, buzzer = CONTROL_BUZZER_SOC;
+	unsigned start = CONTROL_CHARGE_START_SOC, stop = CONTROL_CHARGE_STOP_SOC, hysteresis = CONTROL_HYSTERESIS;
+	if(spec)
+		sscanf(spec, "%u,%u,%u,%u,%u", &limit, &buzzer, &start, &stop, &hysteresis);
+	control_policy_init(&run->policy, limit);
+	run->policy.buzzer_soc = buzzer;
+	run->policy.charge_start_soc = start;
+	run->policy.charge_stop_soc = stop;
+	run->policy.hysteresis = hysteresis;
+}
+
+
+int main(int argc, char **argv)
+{
+	int adc = 0, quiet = 0, binary = 0;
+	double hours = 0;
+	const char *path = NULL;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "-a"))
+			adc = 1;
+		else if(!strcmp(argv[i], "-q"))
+			quiet = 1;
+		else if(!strcmp(argv[i], "-b"))
+			binary = 1;
+		else if(!strcmp(argv[i], "-l") && i + 1 < argc)
+			add_policy(argv[++i]);
+		else if(!strcmp(argv[i], "-g") && i + 1 < argc)
+			hours = atof(argv[++i]);
+		else
+			path = argv[i];
+	}
+
+	if(hours > 0)
+	{
+		generate(hours, binary);
+		return 0;
+	}
+	if(!path)
+	{
+		fprintf(stderr, "usage: %s [-a] [-q] [-l limit[,buzzer,charge_start,charge_stop,hysteresis]] ... trace.csv|trace.bin|-\n"
+				"       %s -g hours [-b] > trace\n", argv[0], argv[0]);
+		return 1;
+	}
+	if(!run_count)
+		add_policy(NULL);
+
+	size_t length = strlen(path);
+	if(length > 4 && !strcmp(path + length - 4, ".bin"))
+		binary = 1;
+	FILE *file = strcmp(path, "-") ? fopen(path, binary ? "rb" : "r") : stdin;
+	if(!file)
+	{
+		perror(path);
+		return 1;
+	}
+
+	clock_t started = clock();
+	struct sample sample, first = { 0, 0, 0 }, previous = { 0, 0, 0 };
+	uint64_t samples = 0;
+	while(read_sample(file, binary, adc, &sample))
+	{
+		uint32_t elapsed = samples ? sample.time - previous.time : 0;
+		uint8_t soc = control_soc(sample.millivolts);
+		for(int r = 0; r < run_count; ++r)
+		{
+			//the time since the previous sample is accounted to the state it was taken in
+			struct run *run = &runs[r];
+			if(run->state.load_on)
+				run->load_on_time += elapsed;
+			if(run->state.buzzer_on)
+				run->buzzer_time += elapsed;
+			if(run->state.charging)
+				run->charge_time += elapsed;
+
+			uint8_t events[CONTROL_MAX_EVENTS];
+			uint8_t count = control_step(&run->policy, &run->state, soc, sample.external_power, events);
+			for(uint8_t e = 0; e < count; ++e)
+			{
+				if(events[e] == EVENT_LOAD_OFF)
+					++run->cutoffs;
+				else if(events[e] == EVENT_CHARGE_ON)
+					++run->charge_cycles;
+				++run->transitions;
+				if(!quiet)
+					printf("%12.3fs  policy %d  %-10s soc=%3u%% %5umV\n", sample.time / 1000.0, r,
+							event_name(events[e]), soc, sample.millivolts);
+			}
+		}
+		if(!samples)
+			first = sample;
+		previous = sample;
+		++samples;
+	}
+	double seconds = (double)(clock() - started) / CLOCKS_PER_SEC;
+
+	double span = (previous.time - first.time) / 1000.0;
+	printf("%llu samples, %.1f h of trace replayed in %.3f s", (unsigned long long)samples, span / 3600.0, seconds);
+	if(seconds > 0)
+		printf(" (%.0fx real time)", span / seconds);
+	printf("\n");
+	for(int r = 0; r < run_count; ++r)
+	{
+		struct run *run = &runs[r];
+		printf("policy %d limit=%u+%u%% buzzer=%u%% charge=%u-%u%%: load on %.2f h, %u cutoffs, buzzer %.2f h, "
+				"%u charge cycles, charging %.2f h, %u transitions\n", r, run->policy.soc_limit, run->policy.hysteresis,
+				run->policy.buzzer_soc, run->policy.charge_start_soc, run->policy.charge_stop_soc,
+				run->load_on_time / 3600000.0, run->cutoffs, run->buzzer_time / 3600000.0, run->charge_cycles,
+				run->charge_time / 3600000.0, run->transitions);
+	}
+	return 0;
+}
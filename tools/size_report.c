@@ -0,0 +1,256 @@
+/*
+ * size_report.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Flash, SRAM and EEPROM usage of a firmware build, read from the
+ * section and symbol tables of its ELF file.
+ *
+ * Build:
+ *   cc -O2 -Wall -o size_report tools/size_report.c
+ *
+ * Usage:
+ *   avr-gcc -mmcu=atmega32 -DF_CPU=12000000UL -Os -o batterybot.elf $(find src -name '*.c')
+ *   size_report [-n count] batterybot.elf
+ *
+ * Every allocated section is listed with its size. The totals follow
+ * the AVR memory map: the flash holds .text (code and the PROGMEM
+ * tables) and the initial values of .data, the SRAM holds .data, .bss
+ * and .noinit, what is left of it is shared by the heap and the stack.
+ * The largest variables of every RAM section and the largest flash
+ * tables are listed next (10 of each, -n changes that), a constant
+ * that shows up in .data is one that is copied to SRAM at start-up.
+ * Both 32 and 64 bit little endian ELF files are read so the tool can
+ * be tried on a host build.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define FLASH_SIZE 32768	//ATmega32
+#define SRAM_SIZE 2048
+#define EEPROM_SIZE 1024
+#define MAX_SECTIONS 64
+#define SHF_ALLOC 0x2
+#define SHT_SYMTAB 2
+#define STT_OBJECT 1
+
+struct section
+{
+	const char *name;
+	uint32_t type;
+	uint64_t flags;
+	uint64_t offset;
+	uint64_t size;
+	uint32_t link;
+	uint64_t entry_size;
+};
+
+struct symbol
+{
+	const char *name;
+	uint64_t size;
+	uint16_t section;
+};
+
+static uint8_t *image;
+static size_t image_size;
+static int elf64;
+static struct section sections[MAX_SECTIONS];
+static int section_count = 0;
+static struct symbol *symbols = NULL;
+static size_t symbol_count = 0;
+
+
+static uint64_t get(uint64_t offset, int length)
+{
+	//little endian field of length bytes, 0 past the end of the file
+	uint64_t value = 0;
+	if(offset + length > image_size)
+		return 0;
+	for(int i = length - 1; i >= 0; --i)
+		value = (value << 8) | image[offset + i];
+	return value;
+}
+
+
+static uint64_t get_word(uint64_t offset)
+{
+	//fields that are 4 bytes in an ELF32 file and 8 bytes in an ELF64 file
+	return get(offset, elf64 ? 8 : 4);
+}
+
+
+static const char* get_string(uint32_t table, uint64_t index)
+{
+	if(table >= (uint32_t)section_count || sections[table].offset + index >= image_size)
+		return "";
+	return (const char *)image + sections[table].offset + index;
+}
+
+
+static int read_sections(void)
+{
+	if(image_size < 52 || memcmp(image, "\177ELF", 4) || image[5] != 1)
+		return 0;	//not a little endian ELF file
+	elf64 = image[4] == 2;
+	uint64_t table = elf64 ? get(0x28, 8) : get(0x20, 4);
+	uint32_t entry_size = get(elf64 ? 0x3A : 0x2E, 2);
+	uint32_t count = get(elf64 ? 0x3C : 0x30, 2);
+	uint32_t names = get(elf64 ? 0x3E : 0x32, 2);
+	if(count > MAX_SECTIONS || table + (uint64_t)count * entry_size > image_size)
+		return 0;
+
+	for(uint32_t i = 0; i < count; ++i)
+	{
+		uint64_t h = table + (uint64_t)i * entry_size;
+		struct section *s = &sections[i];
+		s->type = get(h + 4, 4);
+		s->flags = get_word(h + 8);
+		s->offset = get_word(h + (elf64 ? 0x18 : 0x10));
+		s->size = get_word(h + (elf64 ? 0x20 : 0x14));
+		s->link = get(h + (elf64 ? 0x28 : 0x18), 4);
+		s->entry_size = get_word(h + (elf64 ? 0x38 : 0x24));
+		s->name = (const char *)(uintptr_t)get(h, 4);	//an index until the string table is known
+	}
+	section_count = count;
+	for(int i = 0; i < section_count; ++i)
+		sections[i].name = get_string(names, (uintptr_t)sections[i].name);
+	return 1;
+}
+
+
+static void read_symbols(void)
+{
+	for(int i = 0; i < section_count; ++i)
+	{
+		struct section *s = &sections[i];
+		if(s->type != SHT_SYMTAB || !s->entry_size)
+			continue;
+		size_t count = s->size / s->entry_size;
+		symbols = realloc(symbols, (symbol_count + count) * sizeof(struct symbol));
+		for(size_t n = 0; n < count; ++n)
+		{
+			uint64_t e = s->offset + n * s->entry_size;
+			uint8_t info = get(e + (elf64 ? 4 : 12), 1);
+			if((info & 0x0F) != STT_OBJECT)
+				continue;
+			struct symbol *symbol = &symbols[symbol_count++];
+			symbol->name = get_string(s->link, get(e, 4));
+			symbol->section = get(e + (elf64 ? 6 : 14), 2);
+			symbol->size = elf64 ? get(e + 16, 8) : get(e + 8, 4);
+		}
+	}
+}
+
+
+static int by_size(const void *a, const void *b)
+{
+	const struct symbol *x = a, *y = b;
+	return (x->size < y->size) - (x->size > y->size);
+}
+
+
+static uint64_t section_total(const char *prefix)
+{
+	//sum of the allocated sections whose name starts with prefix
+	uint64_t total = 0;
+	for(int i = 0; i < section_count; ++i)
+		if((sections[i].flags & SHF_ALLOC) && !strncmp(sections[i].name, prefix, strlen(prefix)))
+			total += sections[i].size;
+	return total;
+}
+
+
+static void print_largest(int section, int count)
+{
+	//the symbols are sorted by size, the ones not listed are added up
+	int shown = 0;
+	uint64_t rest = 0;
+	for(size_t i = 0; i < symbol_count; ++i)
+	{
+		if(symbols[i].section != section || !symbols[i].size)
+			continue;
+		if(shown++ < count)
+			printf("    %-32s %6llu\n", symbols[i].name, (unsigned long long)symbols[i].size);
+		else
+			rest += symbols[i].size;
+	}
+	if(shown > count)
+		printf("    %-32s %6llu in %d more\n", "...", (unsigned long long)rest, shown - count);
+}
+
+
+static void print_usage(const char *memory, uint64_t used, uint64_t size)
+{
+	printf("%-8s %6llu of %6llu bytes (%5.1f%%), %lld free\n", memory, (unsigned long long)used,
+			(unsigned long long)size, 100.0 * used / size, (long long)size - (long long)used);
+}
+
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL;
+	int count = 10;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "-n") && i + 1 < argc)
+			count = atoi(argv[++i]);
+		else
+			path = argv[i];
+	}
+	if(!path)
+	{
+		fprintf(stderr, "usage: %s [-n count] firmware.elf\n", argv[0]);
+		return 1;
+	}
+
+	FILE *file = fopen(path, "rb");
+	if(!file)
+	{
+		perror(path);
+		return 1;
+	}
+	fseek(file, 0, SEEK_END);
+	image_size = ftell(file);
+	rewind(file);
+	image = malloc(image_size);
+	if(fread(image, 1, image_size, file) != image_size || !read_sections())
+	{
+		fprintf(stderr, "%s: not a little endian ELF file\n", path);
+		return 1;
+	}
+	fclose(file);
+	read_symbols();
+	qsort(symbols, symbol_count, sizeof(struct symbol), by_size);
+
+	printf("%-20s %8s\n", "section", "bytes");
+	for(int i = 0; i < section_count; ++i)
+		if(sections[i].flags & SHF_ALLOC)
+			printf("%-20s %8llu\n", sections[i].name, (unsigned long long)sections[i].size);
+
+	uint64_t text = section_total(".text"), data = section_total(".data");
+	uint64_t bss = section_total(".bss"), noinit = section_total(".noinit");
+	printf("\n.text %llu, .data %llu, .bss %llu, .noinit %llu\n", (unsigned long long)text,
+			(unsigned long long)data, (unsigned long long)bss, (unsigned long long)noinit);
+	print_usage("flash", text + data, FLASH_SIZE);
+	print_usage("SRAM", data + bss + noinit, SRAM_SIZE);
+	print_usage("EEPROM", section_total(".eeprom"), EEPROM_SIZE);
+
+	for(int i = 0; i < section_count; ++i)
+	{
+		const char *name = sections[i].name;
+		if(!(sections[i].flags & SHF_ALLOC))
+			continue;
+		if(strcmp(name, ".data") && strcmp(name, ".bss") && strcmp(name, ".noinit") && strcmp(name, ".text")
+				&& strcmp(name, ".rodata"))
+			continue;
+		printf("\nlargest objects in %s:\n", name);
+		print_largest(i, count);
+	}
+	free(symbols);
+	free(image);
+	return 0;
+}
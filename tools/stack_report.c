@@ -0,0 +1,264 @@
+/*
+ * stack_report.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Static worst-case stack depth of the firmware, computed from the
+ * call graph files written by gcc with -fcallgraph-info=su.
+ *
+ * Build:
+ *   cc -O2 -Wall -o stack_report tools/stack_report.c
+ *
+ * Usage:
+ *   avr-gcc -mmcu=atmega32 -DF_CPU=12000000UL -Os -fcallgraph-info=su -c $(find src -name '*.c')
+ *   stack_report [-e caller:callee ...] *.ci
+ *
+ * The depth of every root (main and the __vector_ ISRs) is the frame
+ * sizes along its deepest call path plus the return address pushed
+ * by every call. ISRs don't nest, so the worst case for the build is
+ * main plus the deepest ISR. Calls through a function pointer can't
+ * be followed, -e adds the missing edge, e.g. the receive handler
+ * called by the USART_RXC ISR:
+ *   -e __vector_13:telemetry_receive
+ * Recursion, indirect calls and callees without a stack size (library
+ * code built without -fstack-usage) are listed, the depth doesn't
+ * include them.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_NODES 1024
+#define MAX_EDGES 4096
+#define MAX_NAME 128
+#define RETURN_ADDRESS 2	//bytes pushed by a call on a device with up to 128KB of flash
+
+struct node
+{
+	char title[MAX_NAME];	//static functions are prefixed with their file name
+	char name[MAX_NAME];
+	long size;	//-1 when unknown
+	int state;	//0 = not visited, 1 = on the current path, 2 = done
+	long depth;	//worst-case depth including this frame
+	int next;	//callee on the worst-case path, -1 for none
+	int recursive;
+};
+
+struct edge
+{
+	int source;
+	int target;
+};
+
+static struct node nodes[MAX_NODES];
+static int node_count = 0;
+static struct edge edges[MAX_EDGES];
+static int edge_count = 0;
+
+
+static int find_node(const char *title)
+{
+	for(int i = 0; i < node_count; ++i)
+		if(!strcmp(nodes[i].title, title))
+			return i;
+	if(node_count == MAX_NODES)
+	{
+		fprintf(stderr, "too many functions\n");
+		exit(1);
+	}
+	struct node *n = &nodes[node_count];
+	snprintf(n->title, MAX_NAME, "%s", title);
+	snprintf(n->name, MAX_NAME, "%s", title);
+	n->size = -1;
+	n->next = -1;
+	return node_count++;
+}
+
+
+static int find_function(const char *name)
+{
+	//a hint may use the plain name of a static function instead of its title
+	for(int i = 0; i < node_count; ++i)
+		if(!strcmp(nodes[i].name, name))
+			return i;
+	return find_node(name);
+}
+
+
+static void add_edge(int source, int target)
+{
+	for(int i = 0; i < edge_count; ++i)
+		if(edges[i].source == source && edges[i].target == target)
+			return;
+	if(edge_count == MAX_EDGES)
+	{
+		fprintf(stderr, "too many calls\n");
+		exit(1);
+	}
+	edges[edge_count].source = source;
+	edges[edge_count].target = target;
+	++edge_count;
+}
+
+
+static int get_field(const char *line, const char *key, char *value)
+{
+	//copies the quoted value following key, returns 0 when key isn't there
+	const char *p = strstr(line, key);
+	if(!p)
+		return 0;
+	p += strlen(key);
+	int i = 0;
+	while(*p && *p != '"' && i < 2 * MAX_NAME - 1)
+	{
+		if(*p == '\\' && p[1])
+			++p;
+		value[i++] = *p++;
+	}
+	value[i] = '\0';
+	return 1;
+}
+
+
+static void read_graph(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if(!file)
+	{
+		perror(path);
+		exit(1);
+	}
+	char line[1024];
+	char title[2 * MAX_NAME], target[2 * MAX_NAME];
+	while(fgets(line, sizeof(line), file))
+	{
+		if(!strncmp(line, "node:", 5) && get_field(line, "title: \"", title))
+		{
+			struct node *n = &nodes[find_node(title)];
+			//the label reads "name\nfile:line:column\nN bytes (static)" with the newlines escaped
+			const char *label = strstr(line, "label: \"");
+			const char *newline = label ? strstr(label, "\\n") : NULL;
+			if(newline && newline - label - 8 < MAX_NAME)
+			{
+				memcpy(n->name, label + 8, newline - label - 8);
+				n->name[newline - label - 8] = '\0';
+			}
+			const char *p = label ? strstr(label, " bytes (") : NULL;
+			if(p)
+			{
+				while(p > label && p[-1] >= '0' && p[-1] <= '9')
+					--p;
+				n->size = strtol(p, NULL, 10);
+			}
+		}
+		else if(!strncmp(line, "edge:", 5) && get_field(line, "sourcename: \"", title)
+				&& get_field(line, "targetname: \"", target))
+			add_edge(find_node(title), find_node(target));
+	}
+	fclose(file);
+}
+
+
+static long depth(int index)
+{
+	struct node *n = &nodes[index];
+	if(n->state == 2)
+		return n->depth;
+	if(n->state == 1)
+	{
+		n->recursive = 1;
+		return 0;
+	}
+
+	n->state = 1;
+	long deepest = 0;
+	for(int i = 0; i < edge_count; ++i)
+	{
+		if(edges[i].source != index)
+			continue;
+		long d = depth(edges[i].target) + RETURN_ADDRESS;
+		if(d > deepest)
+		{
+			deepest = d;
+			n->next = edges[i].target;
+		}
+	}
+	n->state = 2;
+	n->depth = (n->size > 0 ? n->size : 0) + deepest;
+	return n->depth;
+}
+
+
+static void print_path(int index)
+{
+	for(int i = index; i >= 0; i = nodes[i].next)
+		printf("    %-32s %5ld bytes\n", nodes[i].name, nodes[i].size > 0 ? nodes[i].size : 0);
+}
+
+
+int main(int argc, char **argv)
+{
+	int i = 1;
+	//hints for calls through function pointers, resolved once every graph has been read
+	char *hints[64];
+	int hint_count = 0;
+	for(; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "-e") && i + 1 < argc && hint_count < 64)
+			hints[hint_count++] = argv[++i];
+		else
+			read_graph(argv[i]);
+	}
+	if(!node_count)
+	{
+		fprintf(stderr, "usage: %s [-e caller:callee ...] file.ci ...\n", argv[0]);
+		return 1;
+	}
+	for(int h = 0; h < hint_count; ++h)
+	{
+		char *colon = strchr(hints[h], ':');
+		if(!colon)
+			continue;
+		*colon = '\0';
+		add_edge(find_function(hints[h]), find_function(colon + 1));
+	}
+
+	long main_depth = 0, isr_depth = 0;
+	const char *deepest_isr = NULL;
+	printf("worst-case stack depth per root:\n");
+	for(int n = 0; n < node_count; ++n)
+	{
+		if(strcmp(nodes[n].name, "main") && strncmp(nodes[n].name, "__vector_", 9))
+			continue;
+		long d = depth(n);
+		printf("  %-34s %5ld bytes\n", nodes[n].name, d);
+		print_path(n);
+		if(!strcmp(nodes[n].name, "main"))
+			main_depth = d;
+		else if(d + RETURN_ADDRESS > isr_depth)
+		{
+			//an interrupt pushes the return address like a call
+			isr_depth = d + RETURN_ADDRESS;
+			deepest_isr = nodes[n].name;
+		}
+	}
+	printf("worst case: main %ld + %s %ld = %ld bytes\n", main_depth, deepest_isr ? deepest_isr : "no ISR",
+			isr_depth, main_depth + isr_depth);
+
+	for(int n = 0; n < node_count; ++n)
+	{
+		if(nodes[n].recursive)
+			printf("warning: %s is recursive, the recursion isn't counted\n", nodes[n].name);
+		else if(!strcmp(nodes[n].title, "__indirect_call"))
+		{
+			for(int e = 0; e < edge_count; ++e)
+				if(edges[e].target == n)
+					printf("warning: %s calls through a function pointer, add the callees with -e\n",
+							nodes[edges[e].source].name);
+		}
+		else if(nodes[n].size < 0 && nodes[n].state == 2)
+			printf("warning: no stack size for %s\n", nodes[n].name);
+	}
+	return 0;
+}
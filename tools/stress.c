@@ -0,0 +1,228 @@
+/*
+ * stress.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Stress test of the ISR/main loop primitives of src/spsc.h and
+ * src/snapshot.h, with two threads standing in for the ISR and the
+ * main loop.
+ *
+ * Build:
+ *   cc -O2 -Wall -pthread -I src -o stress tools/stress.c
+ *
+ * Usage:
+ *   stress [-n iterations]
+ *
+ * Each check runs a producer and a consumer thread on the same data:
+ *  - spsc: queues of 4 and 128 entries pass numbered 8 byte entries,
+ *    the consumer checks that none is lost, repeated, reordered or
+ *    torn (both halves of an entry carry the number).
+ *  - snapshot16/snapshot32: a writer keeps writing values whose
+ *    halves match, the reader checks that it never gets a mix of two
+ *    writes.
+ *  - handover: one side fills a buffer and hands it over with
+ *    shared_store8, the other one checks it after shared_load8 and
+ *    hands it back, the way the count down and the Modbus frame
+ *    buffer pass between the main loop and the ISRs.
+ * The threads run on different cores when there are some, so the
+ * fences are checked against a weaker ordering than the AVR's. The
+ * exit status is 1 when a check fails.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "spsc.h"
+#include "snapshot.h"
+
+#define HANDOVER_LENGTH 64	//bytes handed over at a time
+
+struct entry
+{
+	uint32_t number;
+	uint32_t check;	//~number
+};
+
+SPSC_QUEUE(small_queue, struct entry, 4)
+SPSC_QUEUE(large_queue, struct entry, 128)
+
+struct check
+{
+	const char *name;
+	void* (*producer)(void *);
+	void* (*consumer)(void *);
+};
+
+static uint32_t iterations = 10000000;
+static struct small_queue small_queue;
+static struct large_queue large_queue;
+static struct snapshot16 snapshot16 = SNAPSHOT_INIT(0);
+static struct snapshot32 snapshot32 = SNAPSHOT_INIT(0);
+static uint8_t stop;
+static uint8_t owner;	//0: the producer may fill the buffer, 1: the consumer may check it
+static uint8_t buffer[HANDOVER_LENGTH];
+static uint32_t errors;	//counted by the consumers only
+
+
+#define QUEUE_THREADS(queue) \
+static void* queue##_producer(void *argument) \
+{ \
+	for(uint32_t n = 0; n < iterations;) \
+	{ \
+		struct entry entry = { n, ~n }; \
+		if(queue##_push(&queue, &entry)) \
+			++n; \
+		else \
+			sched_yield(); \
+	} \
+	return NULL; \
+} \
+\
+static void* queue##_consumer(void *argument) \
+{ \
+	for(uint32_t n = 0; n < iterations;) \
+	{ \
+		struct entry entry; \
+		if(!queue##_pop(&queue, &entry)) \
+		{ \
+			sched_yield(); \
+			continue; \
+		} \
+		if(entry.number != n || entry.check != ~n) \
+		{ \
+			if(!errors++) \
+				fprintf(stderr, #queue ": got %u/%08x, expected %u\n", entry.number, entry.check, n); \
+			n = entry.number; \
+		} \
+		++n; \
+	} \
+	if(queue##_count(&queue)) \
+		++errors; \
+	return NULL; \
+}
+
+QUEUE_THREADS(small_queue)
+QUEUE_THREADS(large_queue)
+
+
+static void* snapshot16_writer(void *argument)
+{
+	for(uint32_t n = 0; n < iterations; ++n)
+		snapshot16_write(&snapshot16, (n & 0xFF) * 0x0101);
+	shared_store8(&stop, 1);
+	return NULL;
+}
+
+
+static void* snapshot16_reader(void *argument)
+{
+	while(!shared_load8(&stop))
+	{
+		uint16_t value = snapshot16_read(&snapshot16);
+		if((value >> 8) != (value & 0xFF) && !errors++)
+			fprintf(stderr, "snapshot16: torn value %04x\n", value);
+	}
+	return NULL;
+}
+
+
+static void* snapshot32_writer(void *argument)
+{
+	for(uint32_t n = 0; n < iterations; ++n)
+		snapshot32_write(&snapshot32, (n & 0xFFFF) * 0x00010001u);
+	shared_store8(&stop, 1);
+	return NULL;
+}
+
+
+static void* snapshot32_reader(void *argument)
+{
+	while(!shared_load8(&stop))
+	{
+		uint32_t value = snapshot32_read(&snapshot32);
+		if((value >> 16) != (value & 0xFFFF) && !errors++)
+			fprintf(stderr, "snapshot32: torn value %08x\n", value);
+	}
+	return NULL;
+}
+
+
+static void* handover_producer(void *argument)
+{
+	for(uint32_t n = 0; n < iterations / 100; ++n)
+	{
+		while(shared_load8(&owner))
+			sched_yield();	//the other side may be waiting for a core
+		memset(buffer, n, sizeof(buffer));
+		shared_store8(&owner, 1);
+	}
+	return NULL;
+}
+
+
+static void* handover_consumer(void *argument)
+{
+	for(uint32_t n = 0; n < iterations / 100; ++n)
+	{
+		while(!shared_load8(&owner))
+			sched_yield();
+		for(int i = 0; i < HANDOVER_LENGTH; ++i)
+			if(buffer[i] != (uint8_t)n)
+			{
+				if(!errors++)
+					fprintf(stderr, "handover: byte %d of buffer %u is %u\n", i, n, buffer[i]);
+				break;
+			}
+		shared_store8(&owner, 0);
+	}
+	return NULL;
+}
+
+
+static int run(const struct check *check)
+{
+	struct timespec start, end;
+	pthread_t producer, consumer;
+	errors = 0;
+	stop = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pthread_create(&consumer, NULL, check->consumer, NULL);
+	pthread_create(&producer, NULL, check->producer, NULL);
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%-12s %s %8.3f s, %u errors\n", check->name, errors ? "FAIL" : "ok  ", seconds, errors);
+	return errors != 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "-n") && i + 1 < argc && atol(argv[i + 1]) > 0)
+			iterations = atol(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [-n iterations]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	static const struct check checks[] =
+	{
+		{ "spsc4", small_queue_producer, small_queue_consumer },
+		{ "spsc128", large_queue_producer, large_queue_consumer },
+		{ "snapshot16", snapshot16_writer, snapshot16_reader },
+		{ "snapshot32", snapshot32_writer, snapshot32_reader },
+		{ "handover", handover_producer, handover_consumer },
+	};
+	int failed = 0;
+	for(size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); ++i)
+		failed += run(&checks[i]);
+	return failed ? 1 : 0;
+}
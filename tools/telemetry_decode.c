@@ -0,0 +1,374 @@
+/*
+ * telemetry_decode.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: kosmaz
+ *
+ * Host side decoder for the BatteryBot telemetry stream.
+ *
+ * Build:
+ *   cc -O2 -Wall -I src -o telemetry_decode tools/telemetry_decode.c src/frame.c
+ *
+ * Usage:
+ *   telemetry_decode /dev/ttyUSB0     decode frames from a serial port
+ *   telemetry_decode -p               create a pty stand-in for the serial port,
+ *                                     print its name and decode whatever is written to it
+ *   telemetry_decode -s /dev/pts/N    emit synthetic frames to a port, e.g the pty above
+ *   telemetry_decode -d /dev/ttyUSB0  dump the event log of a unit and exit
+ *   telemetry_decode -P /dev/ttyUSB0  print the profiling probes of a unit built
+ *                                     with PROFILING and exit
+ */
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "frame.h"
+#include "events.h"
+
+static const char* event_name(uint8_t code)
+{
+	switch(code)
+	{
+		case EVENT_BOOT: return "BOOT";
+		case EVENT_LOAD_ON: return "LOAD_ON";
+		case EVENT_LOAD_OFF: return "LOAD_OFF";
+		case EVENT_CHARGE_ON: return "CHARGE_ON";
+		case EVENT_CHARGE_OFF: return "CHARGE_OFF";
+		case EVENT_BUZZER_ON: return "BUZZER_ON";
+		case EVENT_BUZZER_OFF: return "BUZZER_OFF";
+		case EVENT_COUNTDOWN_START: return "COUNTDOWN_START";
+		case EVENT_COUNTDOWN_END: return "COUNTDOWN_END";
+		case EVENT_SOC_LIMIT_SET: return "SOC_LIMIT_SET";
+		case EVENT_WARM_RESTART: return "WARM_RESTART";
+		case EVENT_LOAD_SHED: return "LOAD_SHED";
+		case EVENT_LOAD_RESTORE: return "LOAD_RESTORE";
+		case EVENT_CALIBRATED: return "CALIBRATED";
+	}
+	return "UNKNOWN";
+}
+
+
+static int dump_done = 0;	//set once the end of an event log dump or the last profiling probe has been received
+
+static const char* probe_name(uint8_t probe)
+{
+	//same order as the PROF_ probes in prof.h
+	static const char* const names[] = { "battery_manager", "led_display", "scan_keypad_input",
+			"TIMER1_COMPA_vect", "background_tasks" };
+	return (probe < sizeof(names) / sizeof(names[0])) ? names[probe] : "UNKNOWN";
+}
+
+
+static void print_frame(const struct frame_decoder *d)
+{
+	const uint8_t *p = d->payload;
+	switch(d->type)
+	{
+		case FRAME_SNAPSHOT: {
+			if(d->length < FRAME_SNAPSHOT_LENGTH)
+				break;
+			uint8_t flags = p[8];
+			printf("%10u snapshot  %5umV soc=%3u%% limit=%3u%% countdown=%u%s%s%s%s%s\n",
+					frame_get32(p), frame_get16(p + 4), p[6], p[7], frame_get16(p + 9),
+					(flags & FRAME_FLAG_LOAD_ON) ? " LOAD" : "",
+					(flags & FRAME_FLAG_CHARGING) ? " CHARGING" : "",
+					(flags & FRAME_FLAG_BUZZER_ON) ? " BUZZER" : "",
+					(flags & FRAME_FLAG_EXTERNAL_POWER) ? " EXT" : "",
+					(flags & FRAME_FLAG_COUNTDOWN) ? " COUNTDOWN" : "");
+			return;
+		}
+		case FRAME_EVENT: {
+			if(d->length < FRAME_EVENT_LENGTH)
+				break;
+			printf("%10u event     %-15s soc=%3u%%\n", frame_get32(p), event_name(p[4]), p[5]);
+			return;
+		}
+		case FRAME_STATS: {
+			if(d->length < FRAME_STATS_LENGTH)
+				break;
+			printf("           stats     min=%umV max=%umV mean=%umV low=%us cutoffs=%u charges=%u %umAh %umWh\n",
+					frame_get16(p), frame_get16(p + 2), frame_get16(p + 4), frame_get32(p + 6),
+					frame_get16(p + 10), frame_get16(p + 12), frame_get32(p + 14), frame_get32(p + 18));
+			return;
+		}
+		case FRAME_EVLOG: {
+			for(int i = 0; i + FRAME_EVLOG_RECORD_LENGTH <= d->length; i += FRAME_EVLOG_RECORD_LENGTH)
+				printf("%10u log       %-15s soc=%3u%% state=0x%02x page=%u\n", frame_get32(p + i),
+						event_name(p[i + 4]), p[i + 5], p[i + 6], p[i + 7]);
+			return;
+		}
+		case FRAME_BOOT: {
+			if(d->length < FRAME_BOOT_LENGTH)
+				break;
+			uint8_t cause = p[2];
+			printf("           boot      first protection decision after %uus,%s%s%s%s%s%s\n", frame_get16(p),
+					(cause & 0x01) ? " power-on" : "", (cause & 0x02) ? " external" : "",
+					(cause & 0x04) ? " brown-out" : "", (cause & 0x08) ? " watchdog" : "",
+					(cause & 0x10) ? " JTAG" : "", (cause & FRAME_BOOT_WARM) ? " warm restart" : " cold boot");
+			return;
+		}
+		case FRAME_PROFILE: {
+			if(d->length < FRAME_PROFILE_LENGTH)
+				break;
+			//the probes count TIMER1 ticks of 8 CPU cycles
+			uint16_t count = frame_get16(p + 2);
+			printf("           profile   %-17s n=%u min=%u max=%u mean=%u cycles\n", probe_name(p[0]), count,
+					frame_get32(p + 4) * 8, frame_get32(p + 8) * 8, count ? frame_get32(p + 12) / count * 8 : 0);
+			for(int i = 0; i < 16; ++i)
+			{
+				uint16_t n = frame_get16(p + 16 + 2 * i);
+				if(n)
+					printf("                       %8u+ cycles %6u\n", i ? (1u << (i - 1)) * 8 : 0, n);
+			}
+			if(p[0] + 1 >= p[1])
+				dump_done = 1;
+			return;
+		}
+		case FRAME_MEMORY: {
+			if(d->length < FRAME_MEMORY_LENGTH)
+				break;
+			printf("           memory    static=%uB heap=%uB stack=%uB free=%uB\n",
+					frame_get16(p), frame_get16(p + 2), frame_get16(p + 4), frame_get16(p + 6));
+			return;
+		}
+		case FRAME_EVLOG_END: {
+			if(d->length < FRAME_EVLOG_END_LENGTH)
+				break;
+			printf("           log end   %u records\n", frame_get16(p));
+			dump_done = 1;
+			return;
+		}
+	}
+	printf("           frame type 0x%02x, %u bytes\n", d->type, d->length);
+}
+
+
+static void make_raw(int fd)
+{
+	struct termios tio;
+	if(tcgetattr(fd, &tio) < 0)
+		return;	//not a terminal, e.g a plain file
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, B38400);
+	cfsetospeed(&tio, B38400);
+	tcsetattr(fd, TCSANOW, &tio);
+}
+
+
+static int open_pty(void)
+{
+	int fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if(fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0)
+	{
+		perror("posix_openpt");
+		exit(1);
+	}
+	make_raw(fd);
+	printf("%s\n", ptsname(fd));
+	fflush(stdout);
+	return fd;
+}
+
+
+static void emit_dump(int fd)
+{
+	//a full synthetic event log: 24 EEPROM pages and a few records still in RAM
+	uint8_t payload[FRAME_MAX_PAYLOAD], frame[FRAME_MAX_PAYLOAD + FRAME_OVERHEAD];
+	uint16_t count = 0;
+	for(int page = 0; page < 25; ++page)
+	{
+		uint8_t *p = payload;
+		for(int i = 0; i < 4; ++i, ++count)
+		{
+			p = frame_put32(p, count * 60000u);
+			*p++ = EVENT_LOAD_ON + (count % 4);
+			*p++ = 100 - count % 60;
+			*p++ = FRAME_FLAG_LOAD_ON;
+			*p++ = page;
+		}
+		uint8_t n = frame_encode(FRAME_EVLOG, payload, p - payload, frame);
+		if(write(fd, frame, n) < 0)
+			return;
+	}
+	frame_put16(payload, count);
+	uint8_t n = frame_encode(FRAME_EVLOG_END, payload, FRAME_EVLOG_END_LENGTH, frame);
+	if(write(fd, frame, n) < 0)
+		return;
+}
+
+
+static void emit_profile(int fd)
+{
+	//synthetic profiling probes with a histogram around the mean of each
+	uint8_t payload[FRAME_MAX_PAYLOAD], frame[FRAME_MAX_PAYLOAD + FRAME_OVERHEAD];
+	static const uint32_t means[] = { 1200000, 1900, 60, 40, 700 };
+	for(int probe = 0; probe < 5; ++probe)
+	{
+		uint8_t *p = payload;
+		*p++ = probe;
+		*p++ = 5;
+		p = frame_put16(p, 1000);
+		p = frame_put32(p, means[probe] / 2);
+		p = frame_put32(p, means[probe] * 2);
+		p = frame_put32(p, means[probe] * 1000);
+		for(int i = 0; i < 16; ++i)
+		{
+			uint32_t low = i ? 1u << (i - 1) : 0;
+			uint32_t high = 1u << i;
+			p = frame_put16(p, (means[probe] >= 16384 && i == 15) ? 1000
+					: (means[probe] >= low && means[probe] < high) ? 1000 : 0);
+		}
+		uint8_t n = frame_encode(FRAME_PROFILE, payload, FRAME_PROFILE_LENGTH, frame);
+		if(write(fd, frame, n) < 0)
+			return;
+	}
+}
+
+
+static void emit(int fd)
+{
+	/* Stand-in for a unit: a slowly discharging battery with
+	 * a snapshot every 100ms and the matching control events.
+	 */
+	uint8_t payload[FRAME_MAX_PAYLOAD], frame[FRAME_MAX_PAYLOAD + FRAME_OVERHEAD];
+	uint32_t now = 0;
+	uint16_t millivolts = 12000;
+	uint8_t load_on = 1;
+	struct timespec period = { 0, 100 * 1000 * 1000 };
+
+	for(;;)
+	{
+		uint8_t soc = (uint32_t)millivolts * 100 / 12000;
+		uint8_t *p = frame_put32(payload, now);
+		p = frame_put16(p, millivolts);
+		*p++ = soc;
+		*p++ = 50;
+		*p++ = load_on ? FRAME_FLAG_LOAD_ON : 0;
+		frame_put16(p, 0);
+		uint8_t n = frame_encode(FRAME_SNAPSHOT, payload, FRAME_SNAPSHOT_LENGTH, frame);
+
+		if(load_on && soc < 50)
+		{
+			load_on = 0;
+			p = frame_put32(payload, now);
+			*p++ = EVENT_LOAD_OFF;
+			*p = soc;
+			n += frame_encode(FRAME_EVENT, payload, FRAME_EVENT_LENGTH, frame + n);
+		}
+		if(now % 1000 == 0)
+		{
+			p = frame_put16(payload, 412);
+			p = frame_put16(p, 7);
+			p = frame_put16(p, 236);
+			frame_put16(p, 1393);
+			n += frame_encode(FRAME_MEMORY, payload, FRAME_MEMORY_LENGTH, frame + n);
+		}
+		if(write(fd, frame, n) < 0)
+		{
+			perror("write");
+			exit(1);
+		}
+		now += 100;
+		millivolts = (millivolts > 5000) ? millivolts - 25 : 12000;
+		if(millivolts == 12000)
+			load_on = 1;
+
+		uint8_t command;
+		while(read(fd, &command, 1) == 1)
+			if(command == FRAME_COMMAND_DUMP)
+				emit_dump(fd);
+			else if(command == FRAME_COMMAND_PROFILE)
+				emit_profile(fd);
+		nanosleep(&period, NULL);
+	}
+}
+
+
+int main(int argc, char **argv)
+{
+	int fd;
+	if(argc == 2 && !strcmp(argv[1], "-p"))
+		fd = open_pty();
+	else if(argc == 3 && !strcmp(argv[1], "-s"))
+	{
+		fd = open(argv[2], O_RDWR | O_NOCTTY | O_NONBLOCK);
+		if(fd < 0)
+		{
+			perror(argv[2]);
+			return 1;
+		}
+		make_raw(fd);
+		emit(fd);
+		return 0;
+	}
+	else if(argc == 3 && (!strcmp(argv[1], "-d") || !strcmp(argv[1], "-P")))
+	{
+		fd = open(argv[2], O_RDWR | O_NOCTTY);
+		if(fd < 0)
+		{
+			perror(argv[2]);
+			return 1;
+		}
+		make_raw(fd);
+		uint8_t command = (argv[1][1] == 'd') ? FRAME_COMMAND_DUMP : FRAME_COMMAND_PROFILE;
+		if(write(fd, &command, 1) != 1)
+		{
+			perror("write");
+			return 1;
+		}
+	}
+	else if(argc == 2)
+	{
+		fd = open(argv[1], O_RDONLY | O_NOCTTY);
+		if(fd < 0)
+		{
+			perror(argv[1]);
+			return 1;
+		}
+		make_raw(fd);
+	}
+	else
+	{
+		fprintf(stderr, "usage: %s <port> | -p | -s <port> | -d <port> | -P <port>\n", argv[0]);
+		return 1;
+	}
+
+	int dumping = (argc == 3);
+	struct timeval start;
+	gettimeofday(&start, NULL);
+
+	struct frame_decoder decoder;
+	frame_decoder_init(&decoder);
+	uint8_t buffer[256];
+	while(!(dumping && dump_done))
+	{
+		ssize_t n = read(fd, buffer, sizeof(buffer));
+		if(n < 0 && (errno == EINTR || errno == EIO))
+		{
+			//EIO is returned by a pty master while nothing has the slave open
+			usleep(10000);
+			continue;
+		}
+		if(n <= 0)
+			break;
+		for(ssize_t i = 0; i < n; ++i)
+			if(frame_decode(&decoder, buffer[i]))
+				print_frame(&decoder);
+		fflush(stdout);
+	}
+
+	if(dumping && argv[1][1] == 'd')
+	{
+		struct timeval end;
+		gettimeofday(&end, NULL);
+		printf("dump took %ld ms\n", (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000);
+	}
+	return 0;
+}